@@ -0,0 +1,104 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdint>
+
+class aabb {
+  public:
+    interval x, y, z;
+
+    aabb() {} // The default AABB is empty, since intervals are empty by default.
+
+    aabb(const interval& ix, const interval& iy, const interval& iz)
+      : x(ix), y(iy), z(iz) {}
+
+    aabb(const point3& a, const point3& b) {
+        // Treat the two points a and b as extrema for the bounding box, so we don't require a
+        // particular minimum/maximum coordinate order.
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+    }
+
+    aabb(const aabb& box0, const aabb& box1) {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    const interval& axis_interval(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    point3 centroid() const {
+        return point3(0.5*(x.min + x.max), 0.5*(y.min + y.max), 0.5*(z.min + z.max));
+    }
+
+    double surface_area() const {
+        // Empty boxes count as zero area so they never attract the SAH.
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        if (dx < 0 || dy < 0 || dz < 0) return 0;
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    int longest_axis() const {
+        // Returns the index of the longest axis of the bounding box.
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        else
+            return y.size() > z.size() ? 1 : 2;
+    }
+
+    bool hit(const ray& r, interval ray_t) const {
+        const point3& ray_orig = r.origin();
+        const vec3&   ray_dir  = r.direction();
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& ax = axis_interval(axis);
+            const double adinv = 1.0 / ray_dir[axis];
+
+            auto t0 = (ax.min - ray_orig[axis]) * adinv;
+            auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+            if (t0 < t1) {
+                if (t0 > ray_t.min) ray_t.min = t0;
+                if (t1 < ray_t.max) ray_t.max = t1;
+            } else {
+                if (t1 > ray_t.min) ray_t.min = t1;
+                if (t0 < ray_t.max) ray_t.max = t0;
+            }
+
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+};
+
+inline uint32_t morton_spread_bits(uint32_t v) {
+    // Moves bit k of a 10-bit value to bit 3k.
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+inline uint32_t morton_code(const point3& p, const aabb& bounds) {
+    // 30-bit Morton code of p on a 1024^3 grid spanning `bounds`. Bits 3k+2, 3k+1 and 3k hold
+    // bit k of the x, y and z cell, so sorting by code walks a Z-order curve through the box.
+    uint32_t q[3];
+    for (int axis = 0; axis < 3; axis++) {
+        const interval& extent = bounds.axis_interval(axis);
+        double u = extent.size() > 0 ? (p[axis] - extent.min) / extent.size() : 0;
+        q[axis] = static_cast<uint32_t>(std::min(std::max(u * 1024.0, 0.0), 1023.0));
+    }
+    return (morton_spread_bits(q[0]) << 2) | (morton_spread_bits(q[1]) << 1) | morton_spread_bits(q[2]);
+}
+
+#endif
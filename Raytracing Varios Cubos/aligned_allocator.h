@@ -0,0 +1,51 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Allocator for std::vector that honours the alignment of over-aligned types. Before C++17 the
+// default allocator only guarantees alignof(std::max_align_t) (16 bytes), so a vector of
+// alignas(64) nodes can start in the middle of a cache line.
+template <typename T>
+struct aligned_allocator {
+    typedef T value_type;
+
+    aligned_allocator() {}
+    template <typename U> aligned_allocator(const aligned_allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t alignment = alignof(T) < sizeof(void*) ? sizeof(void*) : alignof(T);
+        void* p = nullptr;
+#ifdef _WIN32
+        p = _aligned_malloc(n * sizeof(T), alignment);
+#else
+        if (posix_memalign(&p, alignment, n * sizeof(T)) != 0)
+            p = nullptr;
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const aligned_allocator<T>&, const aligned_allocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const aligned_allocator<T>&, const aligned_allocator<U>&) { return false; }
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "box.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "simd.h"
+#include "sphere.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Batch primitives: many boxes or spheres behind a single hittable, with their geometry kept in
+// structure-of-arrays float blocks of RT_SIMD_WIDTH (8 with AVX2), so one stream of vector
+// instructions tests a ray against a whole block. The float test is only a conservative filter
+// (the bounds are padded outwards); every lane it lets through is re-intersected in double by
+// the primitive's own hit(), so a batch returns exactly what testing each primitive would.
+
+inline vmask batch_lanes(int count) {
+    // Mask of the first `count` lanes of a block; the rest are padding.
+    return mask_from_bits((1 << count) - 1);
+}
+
+class box_batch final : public hittable {
+  public:
+    box_batch() {}
+
+    void add(const box& b) {
+        int lane = static_cast<int>(boxes.size() % RT_SIMD_WIDTH);
+        if (lane == 0)
+            blocks.emplace_back();
+        block& blk = blocks.back();
+        for (int axis = 0; axis < 3; axis++) {
+            blk.lo[axis][lane] = static_cast<float>(b.box_min[axis]) - packet_pad(b.box_min[axis]);
+            blk.hi[axis][lane] = static_cast<float>(b.box_max[axis]) + packet_pad(b.box_max[axis]);
+        }
+        blk.count = lane + 1;
+        boxes.push_back(b);
+        bbox = aabb(bbox, b.bounding_box());
+    }
+
+    size_t size() const { return boxes.size(); }
+
+    int closest(const ray& r, interval ray_t, hit_record& rec) const {
+        // Returns the index of the closest box hit within ray_t, or -1. On a hit, rec holds
+        // its distance, point, face normal and material.
+        int index = nearest(r, ray_t, rec);
+        if (index >= 0)
+            boxes[index].box::finalize(r, rec);
+        return index;
+    }
+
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return closest(r, ray_t, rec) >= 0;
+    }
+
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        return nearest(r, ray_t, rec) >= 0;
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        hit_record rec;
+        return nearest(r, ray_t, rec, true) >= 0;
+    }
+
+    virtual aabb bounding_box() const override { return bbox; }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        for (const auto& b : boxes)
+            b.box::hit_packet(rays, active, hits);
+    }
+
+  public:
+    std::vector<box> boxes;
+
+  private:
+    struct block {
+        float lo[3][RT_SIMD_WIDTH];  // Padded box minimum, per axis and lane
+        float hi[3][RT_SIMD_WIDTH];  // Padded box maximum, per axis and lane
+        int count;                   // Lanes in use
+    };
+
+    std::vector<block> blocks;
+    aabb bbox;
+
+    int nearest(const ray& r, interval ray_t, hit_record& rec, bool any_hit = false) const {
+        // intersect() stage of closest(): sets only rec.t and rec.prim. With any_hit, returns
+        // the first hit found instead of the closest.
+        vfloat org[3], inv[3];
+        for (int axis = 0; axis < 3; axis++) {
+            org[axis] = vfloat(static_cast<float>(r.origin()[axis]));
+            inv[axis] = vfloat(1.0f / static_cast<float>(r.direction()[axis]));
+        }
+
+        int best = -1;
+        for (size_t k = 0; k < blocks.size(); k++) {
+            const block& blk = blocks[k];
+            RT_STAT_ADD(primitive_tests, blk.count);
+            vfloat t_near(static_cast<float>(ray_t.min));
+            vfloat t_far(static_cast<float>(ray_t.max) * 1.0001f);
+            for (int axis = 0; axis < 3; axis++) {
+                vfloat t0 = (vfloat::loadu(blk.lo[axis]) - org[axis]) * inv[axis];
+                vfloat t1 = (vfloat::loadu(blk.hi[axis]) - org[axis]) * inv[axis];
+                t_near = vmax(t_near, vmin(t0, t1));
+                t_far  = vmin(t_far,  vmax(t0, t1));
+            }
+
+            for (int b = bits(batch_lanes(blk.count) & (t_near <= t_far)); b; b &= b - 1) {
+                int index = static_cast<int>(k * RT_SIMD_WIDTH) + packet_hit::lowest_lane(b);
+                if (boxes[index].box::intersect(r, ray_t, rec)) {
+                    if (any_hit)
+                        return index;
+                    best = index;
+                    ray_t.max = rec.t;
+                }
+            }
+        }
+        return best;
+    }
+};
+
+class sphere_batch final : public hittable {
+  public:
+    sphere_batch() {}
+
+    void add(const sphere& s) {
+        int lane = static_cast<int>(spheres.size() % RT_SIMD_WIDTH);
+        if (lane == 0)
+            blocks.emplace_back();
+        block& blk = blocks.back();
+        for (int axis = 0; axis < 3; axis++)
+            blk.center[axis][lane] = static_cast<float>(s.center[axis]);
+        double reach = std::fabs(s.radius) + std::max(std::max(std::fabs(s.center.x()),
+                                                                std::fabs(s.center.y())),
+                                                       std::fabs(s.center.z()));
+        blk.radius[lane] = static_cast<float>(std::fabs(s.radius)) + packet_pad(reach);
+        blk.count = lane + 1;
+        spheres.push_back(s);
+        bbox = aabb(bbox, s.bounding_box());
+    }
+
+    size_t size() const { return spheres.size(); }
+
+    int closest(const ray& r, interval ray_t, hit_record& rec) const {
+        // Returns the index of the closest sphere hit within ray_t, or -1. On a hit, rec holds
+        // its distance, point, normal and material.
+        int index = nearest(r, ray_t, rec);
+        if (index >= 0)
+            spheres[index].sphere::finalize(r, rec);
+        return index;
+    }
+
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return closest(r, ray_t, rec) >= 0;
+    }
+
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        return nearest(r, ray_t, rec) >= 0;
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        hit_record rec;
+        return nearest(r, ray_t, rec, true) >= 0;
+    }
+
+    virtual aabb bounding_box() const override { return bbox; }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        for (const auto& s : spheres)
+            s.sphere::hit_packet(rays, active, hits);
+    }
+
+  public:
+    std::vector<sphere> spheres;
+
+  private:
+    struct block {
+        float center[3][RT_SIMD_WIDTH];  // Center, per axis and lane
+        float radius[RT_SIMD_WIDTH];     // Padded radius, per lane
+        int count;                       // Lanes in use
+    };
+
+    std::vector<block> blocks;
+    aabb bbox;
+
+    int nearest(const ray& r, interval ray_t, hit_record& rec, bool any_hit = false) const {
+        // intersect() stage of closest(): sets only rec.t and rec.prim. With any_hit, returns
+        // the first hit found instead of the closest.
+        vfloat org[3], dir[3];
+        for (int axis = 0; axis < 3; axis++) {
+            org[axis] = vfloat(static_cast<float>(r.origin()[axis]));
+            dir[axis] = vfloat(static_cast<float>(r.direction()[axis]));
+        }
+        vfloat a = dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2];
+
+        int best = -1;
+        for (size_t k = 0; k < blocks.size(); k++) {
+            const block& blk = blocks[k];
+            RT_STAT_ADD(primitive_tests, blk.count);
+
+            // Distance from the center to the ray's closest approach, as in sphere::hit_packet,
+            // then the chord half-length in t.
+            vfloat oc[3], h(0.0f);
+            for (int axis = 0; axis < 3; axis++) {
+                oc[axis] = vfloat::loadu(blk.center[axis]) - org[axis];
+                h = h + oc[axis] * dir[axis];
+            }
+            vfloat s = h / a, f2(0.0f);
+            for (int axis = 0; axis < 3; axis++) {
+                vfloat f = oc[axis] - s * dir[axis];
+                f2 = f2 + f * f;
+            }
+            vfloat radius = vfloat::loadu(blk.radius);
+            vfloat disc = radius * radius - f2;
+            vfloat half_chord = vsqrt(vmax(disc, vfloat(0.0f)) / a);
+
+            vfloat t_min(static_cast<float>(ray_t.min));
+            vfloat t_max(static_cast<float>(ray_t.max) * 1.0001f);
+            vmask candidates = batch_lanes(blk.count) & (disc >= vfloat(0.0f))
+                             & (s + half_chord >= t_min) & (s - half_chord <= t_max);
+
+            for (int b = bits(candidates); b; b &= b - 1) {
+                int index = static_cast<int>(k * RT_SIMD_WIDTH) + packet_hit::lowest_lane(b);
+                if (spheres[index].sphere::intersect(r, ray_t, rec)) {
+                    if (any_hit)
+                        return index;
+                    best = index;
+                    ray_t.max = rec.t;
+                }
+            }
+        }
+        return best;
+    }
+};
+
+template <typename Batch, typename Prim>
+void add_batches(const hittable& node, size_t batch_size, std::vector<shared_ptr<hittable>>& batches) {
+    // Cuts the BVH below `node` into subtrees of at most batch_size primitives, one batch each.
+    // A bvh_node leaf (no right child, its primitives in a hittable_list under left) can hold
+    // more than batch_size primitives; those are split into consecutive chunks.
+    std::vector<const hittable*> leaves;
+    collect_bvh_leaves(node, leaves);
+    auto inner = dynamic_cast<const bvh_node*>(&node);
+    if (leaves.size() > batch_size && inner && inner->right) {
+        add_batches<Batch, Prim>(*inner->left, batch_size, batches);
+        add_batches<Batch, Prim>(*inner->right, batch_size, batches);
+        return;
+    }
+
+    for (size_t first = 0; first < leaves.size(); first += batch_size) {
+        size_t last = std::min(first + batch_size, leaves.size());
+        auto batch = make_shared<Batch>();
+        for (size_t k = first; k < last; k++)
+            batch->add(*static_cast<const Prim*>(leaves[k]));
+        batches.push_back(batch);
+    }
+}
+
+template <typename Batch, typename Prim>
+std::vector<shared_ptr<hittable>> make_batches(const std::vector<Prim>& prims, size_t batch_size = 8) {
+    // Groups the primitives into batches of up to batch_size neighbours. The groups are the
+    // subtrees of an SAH BVH over the primitives, so each batch is compact and the BVH built
+    // over the batches stays nearly as tight as one over the primitives themselves.
+    if (batch_size == 0)
+        throw std::invalid_argument("make_batches: batch_size must be at least 1");
+
+    std::vector<shared_ptr<hittable>> batches;
+    if (prims.empty())
+        return batches;
+
+    hittable_list list;
+    for (const auto& p : prims)
+        list.add(make_shared<Prim>(p));
+    bvh_node root(list);
+    add_batches<Batch, Prim>(root, batch_size, batches);
+    return batches;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef BOX_H
+#define BOX_H
+
+#include "hittable.h"
+#include "material.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// Axis-aligned box intersected with a single slab test, instead of the six separate rectangles
+// that make up a `cube`. Handles rays starting inside the box (refraction through glass cubes)
+// by falling back to the exit face.
+class box final : public hittable {
+  public:
+    box() {}
+    box(const point3& p0, const point3& p1, shared_ptr<material> m)
+      : box_min(p0), box_max(p1), mat(scene_materials().add(m)) {}
+
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return intersect_and_finalize(r, ray_t, rec);
+    }
+
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT(primitive_tests);
+        double t_near, t_far;
+        int near_axis, far_axis;
+        if (!slabs(r, t_near, t_far, near_axis, far_axis))
+            return false;
+
+        // Entry face if it is in range, otherwise the exit face.
+        if (ray_t.surrounds(t_near))
+            rec.t = t_near;
+        else if (ray_t.surrounds(t_far))
+            rec.t = t_far;
+        else
+            return false;
+
+        rec.prim = this;
+        return true;
+    }
+
+    virtual void finalize(const ray& r, hit_record& rec) const override {
+        // Repeats the slab test to tell which face rec.t lies on; it is the same arithmetic as
+        // in intersect(), so the entry distance compares exactly.
+        double t_near, t_far;
+        int near_axis, far_axis;
+        slabs(r, t_near, t_far, near_axis, far_axis);
+
+        vec3 outward_normal(0, 0, 0);
+        if (rec.t == t_near)
+            outward_normal[near_axis] = r.direction()[near_axis] < 0 ? 1 : -1;
+        else
+            outward_normal[far_axis] = r.direction()[far_axis] < 0 ? -1 : 1;
+
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = mat;
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        RT_STAT(primitive_tests);
+        double t_near, t_far;
+        int near_axis, far_axis;
+        return slabs(r, t_near, t_far, near_axis, far_axis)
+            && (ray_t.surrounds(t_near) || ray_t.surrounds(t_far));
+    }
+
+    virtual aabb bounding_box() const override {
+        return aabb(box_min, box_max);
+    }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        RT_STAT_ADD(primitive_tests, lane_count(active));
+        vfloat t_min(rays.t_min), t_max = hits.t_limit();
+
+        // Quick rejection: the plain slab test, widened by an error bound that holds for any
+        // slab. Most tests end here; only lanes that may hit pay for the exact bookkeeping.
+        vfloat t_near(-std::numeric_limits<float>::infinity());
+        vfloat t_far(std::numeric_limits<float>::infinity());
+        float extent = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = static_cast<float>(box_min[axis]), hi = static_cast<float>(box_max[axis]);
+            vfloat inv = rays.inv_direction(axis), orig = rays.origin(axis);
+            vfloat t0 = (vfloat(lo) - orig) * inv;
+            vfloat t1 = (vfloat(hi) - orig) * inv;
+            t_near = vmax(t_near, vmin(t0, t1));
+            t_far  = vmin(t_far,  vmax(t0, t1));
+            extent = std::max(extent, std::max(std::fabs(lo), std::fabs(hi)));
+        }
+        vfloat err = rays.slab_t_error(extent);
+        vfloat margin = err + err + packet_slack(vmax(t_far, vfloat(0.0f)));
+        vmask maybe = active & (t_near <= t_far + margin) & (t_far + err > t_min) & (t_near - err < t_max);
+        if (any(maybe))
+            record_packet_hits(rays, maybe, hits);
+    }
+
+  public:
+    point3 box_min, box_max;
+    const material* mat;
+
+  private:
+    void record_packet_hits(const ray_packet& rays, vmask active, packet_hit& hits) const {
+        // The exact test for the lanes that passed the quick rejection in hit_packet().
+        vfloat t_min(rays.t_min), t_max = hits.t_limit();
+
+        // Entry and exit distances, each with the float error of the slab that set it.
+        vfloat t_near(-std::numeric_limits<float>::infinity()), near_err(0.0f);
+        vfloat t_far(std::numeric_limits<float>::infinity()), far_err(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = static_cast<float>(box_min[axis]), hi = static_cast<float>(box_max[axis]);
+            vfloat inv = rays.inv_direction(axis), orig = rays.origin(axis);
+            vfloat t0 = (vfloat(lo) - orig) * inv;
+            vfloat t1 = (vfloat(hi) - orig) * inv;
+            vfloat err = rays.plane_t_error(axis, std::max(std::fabs(lo), std::fabs(hi)));
+            vfloat enter = vmin(t0, t1), leave = vmax(t0, t1);
+            near_err = select(enter > t_near, err, near_err);
+            far_err  = select(leave < t_far, err, far_err);
+            t_near = vmax(t_near, enter);
+            t_far  = vmin(t_far, leave);
+        }
+
+        // Entry face if it is in range, otherwise the exit face, as in hit(). A ray whose entry
+        // and exit nearly meet grazes an edge, and one whose distance is less accurate than
+        // the slack cannot be ordered against other hits; both are kept, marked uncertain.
+        vfloat margin = near_err + far_err + packet_slack(vmax(t_far, vfloat(0.0f)));
+        vmask overlap = active & (t_near <= t_far + margin);
+        vmask near_ok = overlap & (t_near > t_min) & (t_near - near_err < t_max);
+        vmask far_ok  = andnot(overlap & (t_far > t_min) & (t_far - far_err < t_max), near_ok);
+        vmask hit = near_ok | far_ok;
+        if (!any(hit))
+            return;
+        vfloat t_hit = select(near_ok, t_near, t_far), t_err = select(near_ok, near_err, far_err);
+        hits.mark_uncertain(hit & ((t_near > t_far - margin) | (t_err > vfloat(0.5f) * packet_slack(t_hit))));
+        hits.record(hit, t_hit, this);
+    }
+
+    bool slabs(const ray& r, double& t_near, double& t_far, int& near_axis, int& far_axis) const {
+        // Entry and exit distances of the ray's line through the box, and the axes of the
+        // faces where they happen. Returns false if the line misses the box.
+        t_near = -infinity;
+        t_far = infinity;
+        near_axis = far_axis = 0;
+
+        for (int axis = 0; axis < 3; axis++) {
+            auto invD = 1.0 / r.direction()[axis];
+            auto t0 = (box_min[axis] - r.origin()[axis]) * invD;
+            auto t1 = (box_max[axis] - r.origin()[axis]) * invD;
+            if (invD < 0) std::swap(t0, t1);
+            if (t0 > t_near) { t_near = t0; near_axis = axis; }
+            if (t1 < t_far)  { t_far = t1;  far_axis = axis; }
+        }
+        return t_near <= t_far;
+    }
+};
+
+#endif
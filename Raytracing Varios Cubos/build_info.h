@@ -0,0 +1,37 @@
+#ifndef BUILD_INFO_H
+#define BUILD_INFO_H
+
+#include "simd.h"
+
+#include <string>
+
+// A short description of the build options that change speed or images: the CMake build type,
+// the packet width (simd.h), and whether RT_STATS and RT_DETERMINISTIC are on, e.g.
+// "Release-avx2-deterministic". Results measured or rendered under one configuration are only
+// comparable with others from the same one. The string has no commas or path separators, so it
+// can go in a CSV column or a file name.
+inline std::string build_config() {
+#ifdef RT_BUILD_TYPE
+    std::string config = RT_BUILD_TYPE;
+#else
+    std::string config;
+#endif
+    if (config.empty())
+        config = "NoBuildType";
+#if defined(RT_SIMD_AVX)
+    config += "-avx2";
+#elif defined(RT_SIMD_SSE)
+    config += "-sse";
+#else
+    config += "-scalar";
+#endif
+#ifdef RT_STATS
+    config += "-stats";
+#endif
+#ifdef RT_DETERMINISTIC
+    config += "-deterministic";
+#endif
+    return config;
+}
+
+#endif
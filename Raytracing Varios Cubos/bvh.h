@@ -0,0 +1,195 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <vector>
+
+class bvh_node : public hittable {
+  public:
+    bvh_node(hittable_list list) : bvh_node(list.objects, 0, list.objects.size()) {
+        // There's a C++ subtlety here. This constructor (without span indices) creates an
+        // implicit copy of the hittable list, which we will modify. The lifetime of the copied
+        // list only extends until this constructor exits. That's OK, because we only need to
+        // persist the resulting bounding volume hierarchy.
+    }
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) {
+        bbox = aabb();
+        for (size_t i = start; i < end; i++)
+            bbox = aabb(bbox, objects[i]->bounding_box());
+
+        size_t object_span = end - start;
+        size_t mid;
+        double split_cost = best_split(objects, start, end, axis, mid);
+
+        // Stop splitting once a leaf is at least as cheap as the best split.
+        if (object_span <= max_leaf_size && object_span * intersect_cost <= split_cost) {
+            if (object_span == 1) {
+                left = objects[start];
+            } else {
+                auto leaf = make_shared<hittable_list>();
+                for (size_t i = start; i < end; i++)
+                    leaf->add(objects[i]);
+                left = leaf;
+            }
+            return;
+        }
+
+        auto comparator = [this](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b) {
+            return a->bounding_box().centroid()[axis] < b->bounding_box().centroid()[axis];
+        };
+        std::sort(objects.begin() + start, objects.begin() + end, comparator);
+
+        left = make_shared<bvh_node>(objects, start, mid);
+        right = make_shared<bvh_node>(objects, mid, end);
+    }
+
+    bvh_node(shared_ptr<hittable> left_child, shared_ptr<hittable> right_child, int split_axis)
+      : left(left_child), right(right_child), axis(split_axis)
+    {
+        // Assembles a node from already built subtrees, as the parallel builders do. A null
+        // right child makes a leaf holding only `left_child`.
+        bbox = right ? aabb(left->bounding_box(), right->bounding_box()) : left->bounding_box();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return intersect_and_finalize(r, ray_t, rec);
+    }
+
+    bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT(bvh_nodes);
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        if (!right)
+            return left->intersect(r, ray_t, rec);
+
+        // Visit the child on the near side of the split first; a hit there shrinks the
+        // interval, which lets the far child be culled by its bounding box.
+        bool left_first = r.direction()[axis] >= 0;
+        const hittable& first  = left_first ? *left : *right;
+        const hittable& second = left_first ? *right : *left;
+
+        bool hit_first  = first.intersect(r, ray_t, rec);
+        bool hit_second = second.intersect(r, interval(ray_t.min, hit_first ? rec.t : ray_t.max), rec);
+
+        return hit_first || hit_second;
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override {
+        // Any hit will do, so the children are visited in fixed order.
+        RT_STAT(bvh_nodes);
+        if (!bbox.hit(r, ray_t))
+            return false;
+        return left->occluded(r, ray_t) || (right && right->occluded(r, ray_t));
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        RT_STAT(bvh_nodes);
+        active = aabb_hit_packet(bbox.x, bbox.y, bbox.z, rays, active, hits);
+        if (!any(active))
+            return;
+
+        if (!right) {
+            left->hit_packet(rays, active, hits);
+            return;
+        }
+
+        // Packet rays are coherent, so the first active lane decides the visiting order.
+        int lane = packet_hit::lowest_lane(bits(active));
+        bool left_first = rays.d[axis][lane] >= 0;
+        (left_first ? left : right)->hit_packet(rays, active, hits);
+        (left_first ? right : left)->hit_packet(rays, active, hits);
+    }
+
+  public:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;  // Null for a leaf, whose objects all hang off `left`
+    aabb bbox;
+    int axis = 0;                // Split axis; children are ordered by centroid along it
+
+    static const size_t max_leaf_size = 4;
+    static constexpr double traversal_cost = 1.0;  // SAH cost of visiting one interior node
+    static constexpr double intersect_cost = 1.0;  // SAH cost of testing one object
+
+  private:
+    double best_split(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+                      int& best_axis, size_t& best_mid) const {
+        // Surface area heuristic: for every axis, sort the objects by centroid and sweep all
+        // object-count splits, costing each one as the traversal step plus the expected work
+        // in the children (child area / parent area * child object count).
+        size_t n = end - start;
+        double best_cost = infinity;
+        best_axis = bbox.longest_axis();
+        best_mid = start + n/2;
+        if (n < 2)
+            return best_cost;
+
+        double parent_area = bbox.surface_area();
+        std::vector<double> right_area(n);
+
+        for (int a = 0; a < 3; a++) {
+            std::sort(objects.begin() + start, objects.begin() + end,
+                [a](const shared_ptr<hittable>& p, const shared_ptr<hittable>& q) {
+                    return p->bounding_box().centroid()[a] < q->bounding_box().centroid()[a];
+                });
+
+            aabb right_box;
+            for (size_t i = n - 1; i > 0; i--) {
+                right_box = aabb(right_box, objects[start + i]->bounding_box());
+                right_area[i] = right_box.surface_area();
+            }
+
+            aabb left_box;
+            for (size_t i = 1; i < n; i++) {
+                left_box = aabb(left_box, objects[start + i - 1]->bounding_box());
+                double cost = traversal_cost;
+                if (parent_area > 0)
+                    cost += intersect_cost * (left_box.surface_area() * i
+                                              + right_area[i] * (n - i)) / parent_area;
+                else
+                    cost += intersect_cost * n;
+
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_mid = start + i;
+                }
+            }
+        }
+
+        return best_cost;
+    }
+};
+
+inline void collect_bvh_leaves(const hittable& node, std::vector<const hittable*>& objects) {
+    // Appends every object stored under `node` to `objects`.
+    auto bvh = dynamic_cast<const bvh_node*>(&node);
+    if (!bvh) {
+        objects.push_back(&node);
+        return;
+    }
+    if (bvh->right) {
+        collect_bvh_leaves(*bvh->left, objects);
+        collect_bvh_leaves(*bvh->right, objects);
+        return;
+    }
+    auto list = dynamic_cast<const hittable_list*>(bvh->left.get());
+    if (!list) {
+        objects.push_back(bvh->left.get());
+        return;
+    }
+    for (const auto& object : list->objects)
+        objects.push_back(object.get());
+}
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef BVH4_H
+#define BVH4_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "aligned_allocator.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// One node of a 4-wide BVH: the bounds of all four children in structure-of-arrays form, so a
+// single SSE slab test checks the ray against every child, followed by the child references.
+// The node is cache-line aligned and a child's bounds never straddle a line; bvh4 keeps its nodes
+// in an aligned_allocator vector so that holds in C++11 too.
+struct alignas(64) bvh4_node {
+    float min_x[4], min_y[4], min_z[4];
+    float max_x[4], max_y[4], max_z[4];
+    int32_t  child[4];  // Interior: index of the child node. Leaf: first index into bvh4::prims
+    uint32_t count[4];  // Leaf: number of primitives. 0 marks an interior child (or empty slot)
+
+    void set_empty(int k) {
+        // Inverted bounds, so no ray ever enters the slot.
+        min_x[k] = min_y[k] = min_z[k] = std::numeric_limits<float>::infinity();
+        max_x[k] = max_y[k] = max_z[k] = -std::numeric_limits<float>::infinity();
+        child[k] = -1;
+        count[k] = 0;
+    }
+
+    void set_bounds(int k, const aabb& b) {
+        // Round outwards, so the float box always contains the double one.
+        min_x[k] = float_round_down(b.x.min); max_x[k] = float_round_up(b.x.max);
+        min_y[k] = float_round_down(b.y.min); max_y[k] = float_round_up(b.y.max);
+        min_z[k] = float_round_down(b.z.min); max_z[k] = float_round_up(b.z.max);
+    }
+};
+
+// Wide BVH over the objects of a hittable_list. It is built by collapsing a binary SAH
+// bvh_node tree: each wide node absorbs the grandchildren of its largest binary children until
+// it has four. Traversal then costs roughly half the node fetches of the binary tree.
+class bvh4 : public hittable {
+  public:
+    bvh4(const hittable_list& list) {
+        if (list.objects.empty())
+            return;
+        auto root = make_shared<bvh_node>(list);
+        bbox = root->bounding_box();
+        owned = list.objects;
+        nodes.reserve(list.objects.size());
+        nodes.emplace_back();
+        build(*root, 0, 1);
+    }
+
+    bvh4(const bvh_node& root, const std::vector<shared_ptr<hittable>>& objects)
+      : owned(objects), bbox(root.bounding_box()) {
+        // Collapses an already built binary tree. `objects` keeps its primitives alive.
+        nodes.emplace_back();
+        build(root, 0, 1);
+    }
+
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return intersect_and_finalize(r, ray_t, rec);
+    }
+
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (nodes.empty())
+            return false;
+
+        float o[3], inv[3];
+        for (int axis = 0; axis < 3; axis++) {
+            o[axis] = static_cast<float>(r.origin()[axis]);
+            inv[axis] = 1.0f / static_cast<float>(r.direction()[axis]);
+        }
+
+        bool hit_anything = false;
+        traversal_stack stack(depth);
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const bvh4_node& node = nodes[stack[--top]];
+            RT_STAT(bvh_nodes);
+
+            float t_near[4];
+            int mask = test_children(node, o, inv, ray_t, t_near);
+
+            // Collect the children that were hit, nearest first.
+            int order[4], n = 0;
+            for (int k = 0; k < 4; k++) {
+                if (!(mask & (1 << k))) continue;
+                int m = n++;
+                while (m > 0 && t_near[order[m-1]] > t_near[k]) {
+                    order[m] = order[m-1];
+                    m--;
+                }
+                order[m] = k;
+            }
+
+            // Leaves are intersected right away (nearest first, shrinking the interval);
+            // interior children are pushed farthest first so the nearest is popped next.
+            for (int m = 0; m < n; m++) {
+                int k = order[m];
+                if (node.count[k] == 0) continue;
+                for (uint32_t p = 0; p < node.count[k]; p++) {
+                    if (prims[node.child[k] + p]->intersect(r, ray_t, rec)) {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+            }
+            for (int m = n - 1; m >= 0; m--) {
+                int k = order[m];
+                if (node.count[k] == 0 && node.child[k] >= 0)
+                    stack[top++] = node.child[k];
+            }
+        }
+
+        return hit_anything;
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        // Same traversal as intersect(), minus the sorting: children are pushed in slot order
+        // and the first primitive hit ends the query.
+        if (nodes.empty())
+            return false;
+
+        float o[3], inv[3];
+        for (int axis = 0; axis < 3; axis++) {
+            o[axis] = static_cast<float>(r.origin()[axis]);
+            inv[axis] = 1.0f / static_cast<float>(r.direction()[axis]);
+        }
+
+        traversal_stack stack(depth);
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const bvh4_node& node = nodes[stack[--top]];
+            RT_STAT(bvh_nodes);
+
+            float t_near[4];
+            int mask = test_children(node, o, inv, ray_t, t_near);
+            for (int k = 0; k < 4; k++) {
+                if (!(mask & (1 << k))) continue;
+                if (node.count[k] == 0) {
+                    if (node.child[k] >= 0)
+                        stack[top++] = node.child[k];
+                    continue;
+                }
+                for (uint32_t p = 0; p < node.count[k]; p++)
+                    if (prims[node.child[k] + p]->occluded(r, ray_t))
+                        return true;
+            }
+        }
+        return false;
+    }
+
+    virtual aabb bounding_box() const override { return bbox; }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        if (!nodes.empty())
+            hit_packet_node(0, rays, active, hits);
+    }
+
+  public:
+    std::vector<bvh4_node, aligned_allocator<bvh4_node>> nodes;  // nodes[0] is the root
+    std::vector<const hittable*> prims;  // Leaf primitives, contiguous per leaf
+    int depth = 0;                       // Levels of nodes, counting the root
+
+  private:
+    std::vector<shared_ptr<hittable>> owned;
+    aabb bbox;
+
+    // Node stack of one traversal. Each level pops one node and pushes at most four children,
+    // so 3 * depth + 1 entries always suffice; deep trees spill to the heap.
+    class traversal_stack {
+      public:
+        explicit traversal_stack(int depth) : entries(local) {
+            size_t needed = 3 * static_cast<size_t>(depth) + 1;
+            if (needed > local_size) {
+                heap.resize(needed);
+                entries = heap.data();
+            }
+        }
+        int& operator[](int k) { return entries[k]; }
+
+      private:
+        static const size_t local_size = 256;
+        int local[local_size];
+        std::vector<int> heap;
+        int* entries;
+    };
+
+    static int test_children(const bvh4_node& node, const float* o, const float* inv,
+                             const interval& ray_t, float* t_near) {
+        // Slab test of one ray against the four children. Returns a bitmask of the children
+        // hit within ray_t, and writes each child's entry distance to t_near.
+        float t_lo = static_cast<float>(ray_t.min);
+        float t_hi = float_round_up(ray_t.max);
+#ifdef __SSE2__
+        __m128 tmin = _mm_set1_ps(t_lo), tmax = _mm_set1_ps(t_hi);
+        const float* lo[3] = { node.min_x, node.min_y, node.min_z };
+        const float* hi[3] = { node.max_x, node.max_y, node.max_z };
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 org = _mm_set1_ps(o[axis]), id = _mm_set1_ps(inv[axis]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(lo[axis]), org), id);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(hi[axis]), org), id);
+            tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+            tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+        }
+        _mm_storeu_ps(t_near, tmin);
+        return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+        int mask = 0;
+        const float* lo[3] = { node.min_x, node.min_y, node.min_z };
+        const float* hi[3] = { node.max_x, node.max_y, node.max_z };
+        for (int k = 0; k < 4; k++) {
+            float tmin = t_lo, tmax = t_hi;
+            for (int axis = 0; axis < 3; axis++) {
+                float t0 = (lo[axis][k] - o[axis]) * inv[axis];
+                float t1 = (hi[axis][k] - o[axis]) * inv[axis];
+                tmin = std::max(tmin, std::min(t0, t1));
+                tmax = std::min(tmax, std::max(t0, t1));
+            }
+            t_near[k] = tmin;
+            if (tmin <= tmax) mask |= 1 << k;
+        }
+        return mask;
+#endif
+    }
+
+    void hit_packet_node(int index, const ray_packet& rays, vmask active, packet_hit& hits) const {
+        RT_STAT(bvh_nodes);
+        const bvh4_node& node = nodes[index];
+        for (int k = 0; k < 4; k++) {
+            if (node.count[k] == 0 && node.child[k] < 0) continue;
+            // The node's bounds were rounded outwards when it was built.
+            float lo[3] = { node.min_x[k], node.min_y[k], node.min_z[k] };
+            float hi[3] = { node.max_x[k], node.max_y[k], node.max_z[k] };
+            vmask lanes = aabb_hit_packet(lo, hi, rays, active, hits);
+            if (!any(lanes)) continue;
+
+            if (node.count[k] == 0) {
+                hit_packet_node(node.child[k], rays, lanes, hits);
+            } else {
+                for (uint32_t p = 0; p < node.count[k]; p++)
+                    prims[node.child[k] + p]->hit_packet(rays, lanes, hits);
+            }
+        }
+    }
+
+    static bool is_interior(const hittable& h) {
+        auto node = dynamic_cast<const bvh_node*>(&h);
+        return node && node->right;
+    }
+
+    void collect_leaf(const hittable& h) {
+        // Appends the primitives under a binary leaf to `prims`.
+        auto node = dynamic_cast<const bvh_node*>(&h);
+        const hittable& payload = node ? *node->left : h;
+        auto list = dynamic_cast<const hittable_list*>(&payload);
+        if (node && list) {
+            for (const auto& object : list->objects)
+                prims.push_back(object.get());
+        } else {
+            prims.push_back(&payload);
+        }
+    }
+
+    void build(const hittable& binary, int index, int level) {
+        // Fills nodes[index], which sits `level` nodes deep, with up to four children taken
+        // from the binary subtree `binary`.
+        depth = std::max(depth, level);
+        std::vector<const hittable*> children;
+        if (is_interior(binary)) {
+            const auto& node = static_cast<const bvh_node&>(binary);
+            children.push_back(node.left.get());
+            children.push_back(node.right.get());
+        } else {
+            children.push_back(&binary);
+        }
+
+        // Open the interior child with the largest surface area until four slots are used.
+        while (children.size() < 4) {
+            int best = -1;
+            double best_area = -1;
+            for (size_t c = 0; c < children.size(); c++) {
+                double area = children[c]->bounding_box().surface_area();
+                if (is_interior(*children[c]) && area > best_area) {
+                    best = static_cast<int>(c);
+                    best_area = area;
+                }
+            }
+            if (best < 0) break;
+
+            auto node = static_cast<const bvh_node*>(children[best]);
+            children[best] = node->left.get();
+            children.push_back(node->right.get());
+        }
+
+        for (int k = 0; k < 4; k++)
+            nodes[index].set_empty(k);
+
+        for (size_t k = 0; k < children.size(); k++) {
+            nodes[index].set_bounds(static_cast<int>(k), children[k]->bounding_box());
+            if (is_interior(*children[k])) {
+                int child_index = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+                nodes[index].child[k] = child_index;
+                nodes[index].count[k] = 0;
+                build(*children[k], child_index, level + 1);
+            } else {
+                size_t first = prims.size();
+                collect_leaf(*children[k]);
+                nodes[index].child[k] = static_cast<int32_t>(first);
+                nodes[index].count[k] = static_cast<uint32_t>(prims.size() - first);
+            }
+        }
+    }
+};
+
+#endif
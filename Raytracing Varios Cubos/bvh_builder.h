@@ -0,0 +1,326 @@
+#ifndef BVH_BUILDER_H
+#define BVH_BUILDER_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parallel BVH builders. Both produce the same bvh_node trees as the serial sweep builder
+// (so bvh4 can collapse either), but split the work into tasks on a thread_pool:
+//
+//   binned_sah  Top-down SAH with the candidate splits reduced to a fixed number of centroid
+//               bins per axis. Subtrees are built as independent tasks. Close to the sweep
+//               builder's quality at a fraction of its cost.
+//   lbvh        Linear BVH: sort the primitives along a 30-bit Morton curve of their centroids
+//               and split each range at the highest differing code bit. Much faster to build,
+//               somewhat worse trees, which suits scenes that are rebuilt every frame.
+//   sweep_sah   The serial full-sweep builder of bvh_node, kept as the quality reference.
+enum class bvh_build_mode { sweep_sah, binned_sah, lbvh };
+
+inline bool parse_bvh_build_mode(const std::string& name, bvh_build_mode& mode) {
+    if (name == "sweep")  { mode = bvh_build_mode::sweep_sah;  return true; }
+    if (name == "binned") { mode = bvh_build_mode::binned_sah; return true; }
+    if (name == "lbvh")   { mode = bvh_build_mode::lbvh;       return true; }
+    return false;
+}
+
+// What a build produced, to choose a builder per job.
+struct bvh_build_stats {
+    double seconds = 0;   // Wall time of the build
+    double sah_cost = 0;  // Expected cost of a random ray, in bvh_node cost units
+    int interior_nodes = 0;
+    int leaves = 0;
+};
+
+void bvh_tree_cost(const hittable& node, double root_area, bvh_build_stats& stats) {
+    // Accumulates the SAH cost of the subtree under `node`: every interior node costs a
+    // traversal step and every leaf its object tests, each weighted by the probability
+    // (area ratio) that a ray through the root box reaches it.
+    auto bvh = dynamic_cast<const bvh_node*>(&node);
+    double p = root_area > 0 ? node.bounding_box().surface_area() / root_area : 1.0;
+
+    if (bvh && bvh->right) {
+        stats.interior_nodes++;
+        stats.sah_cost += bvh_node::traversal_cost * p;
+        bvh_tree_cost(*bvh->left, root_area, stats);
+        bvh_tree_cost(*bvh->right, root_area, stats);
+        return;
+    }
+
+    const hittable& payload = bvh ? *bvh->left : node;
+    auto list = dynamic_cast<const hittable_list*>(&payload);
+    size_t count = (bvh && list) ? list->objects.size() : 1;
+    stats.leaves++;
+    stats.sah_cost += bvh_node::intersect_cost * count * p;
+}
+
+class bvh_builder {
+  public:
+    static const int bin_count = 16;
+    static const size_t task_threshold = 2048;  // Smaller ranges are built serially
+
+    bvh_builder(thread_pool& p) : pool(p) {}
+
+    shared_ptr<bvh_node> build(const std::vector<shared_ptr<hittable>>& list, bvh_build_mode mode,
+                               bvh_build_stats* stats = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        shared_ptr<bvh_node> root;
+
+        if (!list.empty()) {
+            if (mode == bvh_build_mode::sweep_sah) {
+                auto copy = list;
+                root = make_shared<bvh_node>(copy, 0, copy.size());
+            } else {
+                prepare(list);
+                auto tree = (mode == bvh_build_mode::binned_sah)
+                          ? build_binned(0, static_cast<int>(refs.size()))
+                          : build_lbvh();
+                root = std::dynamic_pointer_cast<bvh_node>(tree);
+                if (!root)
+                    root = make_shared<bvh_node>(tree, nullptr, 0);
+            }
+        }
+
+        if (stats) {
+            *stats = bvh_build_stats();
+            stats->seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            if (root)
+                bvh_tree_cost(*root, root->bounding_box().surface_area(), *stats);
+        }
+
+        objects.clear();
+        refs.clear();
+        return root;
+    }
+
+  private:
+    // Per-primitive build data; the builders reorder these instead of the shared_ptrs.
+    struct build_ref {
+        aabb     box;
+        point3   centroid;
+        uint32_t code;    // Morton code (lbvh only)
+        int      object;  // Index into `objects`
+    };
+
+    thread_pool& pool;
+    std::vector<shared_ptr<hittable>> objects;
+    std::vector<build_ref> refs;
+    aabb centroid_bounds;
+
+    template <typename F>
+    void parallel_for(int n, F body) {
+        // Runs body(begin, end) over n items in chunks, one task per chunk.
+        int chunks = std::min(pool.size() * 4, std::max(1, n / 1024));
+        task_group group(pool);
+        for (int c = 0; c < chunks; c++) {
+            int begin = static_cast<int>(static_cast<long long>(n) * c / chunks);
+            int end = static_cast<int>(static_cast<long long>(n) * (c + 1) / chunks);
+            group.run([=] { body(begin, end); });
+        }
+        group.wait();
+    }
+
+    void prepare(const std::vector<shared_ptr<hittable>>& list) {
+        objects = list;
+        refs.resize(objects.size());
+        parallel_for(static_cast<int>(refs.size()), [this](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                refs[i].box = objects[i]->bounding_box();
+                refs[i].centroid = refs[i].box.centroid();
+                refs[i].object = i;
+            }
+        });
+
+        centroid_bounds = aabb();
+        for (const auto& ref : refs)
+            centroid_bounds = aabb(centroid_bounds, aabb(ref.centroid, ref.centroid));
+    }
+
+    shared_ptr<hittable> make_leaf(int start, int end) const {
+        if (end - start == 1)
+            return objects[refs[start].object];
+        auto leaf = make_shared<hittable_list>();
+        for (int i = start; i < end; i++)
+            leaf->add(objects[refs[i].object]);
+        return make_shared<bvh_node>(leaf, nullptr, 0);
+    }
+
+    template <typename F>
+    shared_ptr<hittable> make_interior(int start, int mid, int end, int axis, F build_half) {
+        // Builds both halves with build_half(start, end), the left one as a separate task
+        // when the range is large enough to be worth it.
+        shared_ptr<hittable> left, right;
+        if (end - start >= static_cast<int>(task_threshold)) {
+            task_group group(pool);
+            group.run([&] { left = build_half(start, mid); });
+            right = build_half(mid, end);
+            group.wait();
+        } else {
+            left = build_half(start, mid);
+            right = build_half(mid, end);
+        }
+        return make_shared<bvh_node>(left, right, axis);
+    }
+
+    shared_ptr<hittable> build_binned(int start, int end) {
+        int n = end - start;
+        if (n == 1)
+            return make_leaf(start, end);
+
+        aabb bounds, cbounds;
+        for (int i = start; i < end; i++) {
+            bounds = aabb(bounds, refs[i].box);
+            cbounds = aabb(cbounds, aabb(refs[i].centroid, refs[i].centroid));
+        }
+
+        // Bin the centroids on every axis and sweep the bin boundaries, costing each split
+        // as in bvh_node::best_split.
+        double parent_area = bounds.surface_area();
+        double best_cost = infinity;
+        int best_axis = -1, best_bin = 0;
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& extent = cbounds.axis_interval(axis);
+            if (extent.size() <= 0)
+                continue;
+
+            aabb bin_box[bin_count];
+            int bin_n[bin_count] = {};
+            double scale = bin_count / extent.size();
+            for (int i = start; i < end; i++) {
+                int b = bin_of(refs[i].centroid[axis], extent.min, scale);
+                bin_box[b] = aabb(bin_box[b], refs[i].box);
+                bin_n[b]++;
+            }
+
+            double right_area[bin_count];
+            int right_n[bin_count];
+            aabb right_box;
+            int count = 0;
+            for (int b = bin_count - 1; b > 0; b--) {
+                right_box = aabb(right_box, bin_box[b]);
+                count += bin_n[b];
+                right_area[b] = right_box.surface_area();
+                right_n[b] = count;
+            }
+
+            aabb left_box;
+            count = 0;
+            for (int b = 1; b < bin_count; b++) {
+                left_box = aabb(left_box, bin_box[b - 1]);
+                count += bin_n[b - 1];
+                if (count == 0 || right_n[b] == 0)
+                    continue;
+
+                double cost = bvh_node::traversal_cost;
+                if (parent_area > 0)
+                    cost += bvh_node::intersect_cost * (left_box.surface_area() * count
+                                                        + right_area[b] * right_n[b]) / parent_area;
+                else
+                    cost += bvh_node::intersect_cost * n;
+
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        if (n <= static_cast<int>(bvh_node::max_leaf_size) && n * bvh_node::intersect_cost <= best_cost)
+            return make_leaf(start, end);
+
+        int mid;
+        int axis = best_axis;
+        if (axis < 0) {
+            // Every centroid coincides: no bin split exists, so halve the range.
+            axis = bounds.longest_axis();
+            mid = start + n/2;
+        } else {
+            const interval& extent = cbounds.axis_interval(axis);
+            double scale = bin_count / extent.size();
+            double lo = extent.min;
+            int split = best_bin;
+            mid = static_cast<int>(std::partition(refs.begin() + start, refs.begin() + end,
+                [=](const build_ref& ref) {
+                    return bin_of(ref.centroid[axis], lo, scale) < split;
+                }) - refs.begin());
+        }
+
+        return make_interior(start, mid, end, axis,
+                             [this](int s, int e) { return build_binned(s, e); });
+    }
+
+    static int bin_of(double c, double lo, double scale) {
+        int b = static_cast<int>((c - lo) * scale);
+        return std::min(std::max(b, 0), bin_count - 1);
+    }
+
+    shared_ptr<hittable> build_lbvh() {
+        // Quantise the centroids to a 1024^3 grid, interleave the bits and sort.
+        parallel_for(static_cast<int>(refs.size()), [this](int begin, int end) {
+            for (int i = begin; i < end; i++)
+                refs[i].code = morton_code(refs[i].centroid, centroid_bounds);
+        });
+        sort_by_code(0, static_cast<int>(refs.size()));
+        return build_lbvh_range(0, static_cast<int>(refs.size()), 29);
+    }
+
+    void sort_by_code(int start, int end) {
+        // Parallel merge sort: halves are sorted as separate tasks, then merged in place.
+        auto by_code = [](const build_ref& a, const build_ref& b) { return a.code < b.code; };
+        if (end - start < static_cast<int>(task_threshold) * 4) {
+            std::sort(refs.begin() + start, refs.begin() + end, by_code);
+            return;
+        }
+        int mid = start + (end - start) / 2;
+        {
+            task_group group(pool);
+            group.run([=] { sort_by_code(start, mid); });
+            sort_by_code(mid, end);
+            group.wait();
+        }
+        std::inplace_merge(refs.begin() + start, refs.begin() + mid, refs.begin() + end, by_code);
+    }
+
+    shared_ptr<hittable> build_lbvh_range(int start, int end, int bit) {
+        // refs[start, end) is sorted by code and agrees on every bit above `bit`. Split where
+        // the highest bit that still differs flips from 0 to 1.
+        int n = end - start;
+        if (n <= static_cast<int>(bvh_node::max_leaf_size))
+            return make_leaf(start, end);
+
+        uint32_t first = refs[start].code, last = refs[end - 1].code;
+        if (first == last) {
+            // Identical codes: no bit left to split on, so halve the range.
+            aabb bounds;
+            for (int i = start; i < end; i++)
+                bounds = aabb(bounds, refs[i].box);
+            return make_interior(start, start + n/2, end, bounds.longest_axis(),
+                                 [this](int s, int e) { return build_lbvh_range(s, e, 0); });
+        }
+
+        while (bit > 0 && !((first ^ last) >> bit & 1))
+            bit--;
+        uint32_t mask = 1u << bit;
+        int mid = static_cast<int>(std::partition_point(refs.begin() + start, refs.begin() + end,
+            [=](const build_ref& ref) { return !(ref.code & mask); }) - refs.begin());
+
+        // Bits 3k+2, 3k+1 and 3k hold x, y and z.
+        return make_interior(start, mid, end, 2 - bit % 3,
+                             [this, bit](int s, int e) { return build_lbvh_range(s, e, std::max(bit - 1, 0)); });
+    }
+};
+
+#endif
@@ -3,17 +3,35 @@
 
 #include "rtweekend.h"
 
+#include "checkpoint.h"
 #include "color.h"
+#include "diagnostics.h"
+#include "framebuffer.h"
 #include "hittable.h"
+#include "image_writer.h"
 #include "material.h"
-
+#include "sampler.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "wavefront.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <string>
 
 class camera {
   public:
     double aspect_ratio = 1.0;  // Ratio of image width over height
     int    image_width  = 720;  // Rendered image width in pixel count
     int    max_depth    = 10;   // Maximum number of ray bounces into scene
+    int    roulette_depth = 3;        // Bounces before Russian roulette may end a path (0 = never)
+    double roulette_threshold = 0.1;  // Roulette only plays paths whose throughput is below this
+    double min_throughput = 1e-4;     // Paths attenuated below this are ended outright (0 = never)
     double vfov = 90;  // Vertical view angle (field of view)
     point3 lookfrom = point3(0,0,0);   // Point camera is looking from
     point3 lookat   = point3(0,0,-1);  // Point camera is looking at
@@ -21,38 +39,167 @@ class camera {
     double defocus_angle = 0;  // Variation angle of rays through each pixel
     double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
     int    samples_per_pixel = 100;   // Count of random samples for each pixel
-
-
-
+    int    num_threads = 0;    // Worker threads for the tiled renderer (0 = all hardware threads)
+    int    tile_size   = 16;   // Edge length of a square render tile, in pixels
+    uint64_t seed      = 0;    // Base seed of the per-pixel, per-sample random streams
+
+    bool   adaptive_sampling  = false;  // Stop sampling a pixel once its error estimate is small
+    int    min_samples        = 16;     // Adaptive: samples every pixel takes before testing
+    double adaptive_threshold = 0.02;   // Adaptive: target standard error, relative to brightness
+
+    int    samples_per_pass    = 4;     // Progressive: samples added to every pixel per pass
+    std::string checkpoint_path;        // Progressive: checkpoint file (empty = no checkpoints)
+    double checkpoint_interval = 60;    // Progressive: seconds between checkpoints
+    std::function<bool(const accumulation_buffer&)> on_pass;  // Progressive: called after every pass; false stops
+
+    bool   packet_primary_rays = false; // Trace camera rays in SIMD packets of simd_width pixels
+    bool   jitter = false;              // Jitter each sample's ray within its pixel (antialiasing)
+    bool   primary_hit_cache = true;    // Trace a pinhole camera's identical primary rays once per pixel
+    sampler_type sampling = sampler_type::independent;  // Sequence behind each sample's random numbers
+    bool   wavefront = false;           // Advance a tile's paths in waves, stage by stage (wavefront.h)
+    int    wavefront_size = 4096;       // Wavefront: paths per wave
+    bool   sort_secondary_rays = false; // Wavefront: sort bounced rays by direction and origin first
+    std::string stats_path;             // RT_STATS builds: also write each render's counters here
+    render_diagnostics* diagnostics = nullptr;  // Per-pixel cost buffers to fill (null = none)
 
     void render(const hittable& world) {
+        framebuffer image;
+        render(world, image);
+        write_ppm_ascii(std::cout, image);
+    }
+
+    void render(const hittable& world, framebuffer& image) {
         initialize();
 
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-        for (int j = 0; j < image_height; ++j) {
-            std::clog << "Scanlines remaining: " << (image_height - j) << "\n";
-            for (int i = 0; i < image_width; ++i) {
+        image.resize(image_width, image_height);
+        if (diagnostics)
+            diagnostics->resize(image_width, image_height);
+        auto start = start_render_stats();
+        long long samples = render_tiles(world, image);
+        average_spp = static_cast<double>(samples) / (static_cast<double>(image_width) * image_height);
 
-                color pixel_color(0,0,0);
-
-                for (int sample = 0; sample < samples_per_pixel; sample++){
-                    // auto offset = sample_square();
-                    auto offset = vec3(0,0,0);
-                    auto pixel_center = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
+        if (adaptive_sampling)
+            std::clog << "Average samples per pixel: " << average_spp
+                      << " (max " << samples_per_pixel << ")\n";
+        std::clog << "Done.                 \n";
+        report_render_stats(start);
+    }
 
-                    auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
-                    auto ray_direction = pixel_center - ray_origin;
-                    ray r(ray_origin, ray_direction);
+    double average_samples_per_pixel() const {
+        // Mean number of samples the last render() actually spent per pixel.
+        return average_spp;
+    }
 
-                    pixel_color += ray_color(r, max_depth, world);
-                }
+    long long render_tiles(const hittable& world, framebuffer& image) const {
+        // Splits the image into tiles and traces them on a work-stealing thread pool. Each
+        // tile writes only its own pixels, so no locking is needed on the framebuffer. Every
+        // sample seeds its own random stream and each pixel sums its samples in sample order,
+        // so the image does not depend on num_threads or on the order the tiles run in.
+        int tiles_x = (image_width + tile_size - 1) / tile_size;
+        int tiles_y = (image_height + tile_size - 1) / tile_size;
+        std::atomic<int> tiles_remaining(tiles_x * tiles_y);
+        std::atomic<long long> samples_taken(0);
+        std::mutex log_mutex;
+
+        thread_pool pool(num_threads);
+        for_each_tile(pool, [&](int x0, int x1, int y0, int y1) {
+            sampler_scope scope(sampling, seed);
+            auto tile_start = std::chrono::steady_clock::now();
+            samples_taken += render_tile(world, image, x0, x1, y0, y1);
+            record_tile_time(x0, x1, y0, y1, tile_start);
+
+            int remaining = --tiles_remaining;
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+        });
+        std::clog << '\n';
+        return samples_taken;
+    }
 
+    bool render_progressive(const hittable& world, framebuffer& image, bool resume = false) {
+        // Renders in passes of samples_per_pass samples per pixel into a floating-point
+        // accumulation buffer until samples_per_pixel is reached. With a checkpoint_path, the
+        // buffer is saved every checkpoint_interval seconds and after the last pass; `resume`
+        // continues from that file instead of starting over. on_pass, when set, sees the buffer
+        // after every pass and can end the render early. Returns false if the checkpoint does
+        // not belong to this image.
+        initialize();
 
-                write_color(std::cout, pixel_color / samples_per_pixel);
+        render_checkpoint ckpt;
+        if (resume && !checkpoint_path.empty() && load_checkpoint(checkpoint_path, ckpt)) {
+            if (ckpt.accum.width != image_width || ckpt.accum.height != image_height) {
+                std::clog << "Checkpoint '" << checkpoint_path << "' is " << ckpt.accum.width << 'x'
+                          << ckpt.accum.height << ", not " << image_width << 'x' << image_height << "\n";
+                return false;
+            }
+            std::string settings = describe(current_sampling_settings());
+            if (ckpt.settings != settings) {
+                std::clog << "Checkpoint '" << checkpoint_path << "' was rendered with " << ckpt.settings
+                          << ",\n  not " << settings << "\n";
+                return false;
             }
+            seed = ckpt.seed;  // Continue the checkpoint's random streams
+            std::clog << "Resuming from '" << checkpoint_path << "' at "
+                      << ckpt.accum.samples << " samples per pixel\n";
+        } else {
+            if (resume)
+                std::clog << "No usable checkpoint at '" << checkpoint_path << "', starting over\n";
+            ckpt.seed = seed;
+            ckpt.settings = describe(current_sampling_settings());
+            ckpt.accum.resize(image_width, image_height);
         }
+        if (diagnostics)
+            diagnostics->resize(image_width, image_height);
+
+        thread_pool pool(num_threads);
+        auto start = start_render_stats();
+        auto last_save = std::chrono::steady_clock::now();
+        int pass_size = std::max(1, samples_per_pass);
+
+        while (ckpt.accum.samples < samples_per_pixel) {
+            int first = ckpt.accum.samples;
+            int count = std::min(pass_size, samples_per_pixel - first);
+
+            for_each_tile(pool, [&](int x0, int x1, int y0, int y1) {
+                sampler_scope scope(sampling, seed);
+                auto tile_start = std::chrono::steady_clock::now();
+                pixel_cost_meter meter;
+                for (int j = y0; j < y1; ++j) {
+                    for (int i = x0; i < x1; ++i) {
+                        primary_hit storage;
+                        const primary_hit* primary = cached_primary(world, i, j, storage);
+                        color pass_color(0,0,0);
+                        for (int sample = first; sample < first + count; sample++)
+                            pass_color += sample_pixel(world, i, j, sample, primary);
+                        ckpt.accum.add(i, j, pass_color);
+                        if (diagnostics)
+                            diagnostics->add_pixel(i, j, count, meter.take());
+                    }
+                }
+                record_tile_time(x0, x1, y0, y1, tile_start);
+            });
+            ckpt.accum.samples += count;
+            std::clog << "\rSamples per pixel: " << ckpt.accum.samples << " / "
+                      << samples_per_pixel << ' ' << std::flush;
+
+            bool stopped = on_pass && !on_pass(ckpt.accum);
+            bool finished = stopped || ckpt.accum.samples >= samples_per_pixel;
+            std::chrono::duration<double> since_save = std::chrono::steady_clock::now() - last_save;
+            if (!checkpoint_path.empty() && (finished || since_save.count() >= checkpoint_interval)) {
+                if (!save_checkpoint(checkpoint_path, ckpt))
+                    std::clog << "\nCould not write checkpoint '" << checkpoint_path << "'\n";
+                last_save = std::chrono::steady_clock::now();
+            }
+            if (stopped)
+                break;
+        }
+        std::clog << '\n';
 
+        ckpt.accum.resolve(image);
+        average_spp = ckpt.accum.samples;
         std::clog << "Done.                 \n";
+        report_render_stats(start);
+        return true;
     }
 
   private:
@@ -64,7 +211,16 @@ class camera {
     vec3   u, v, w;              // Camera frame basis vectors
     vec3   defocus_disk_u;       // Defocus disk horizontal radius
     vec3   defocus_disk_v;       // Defocus disk vertical radius
-    
+    double average_spp = 0;      // Samples per pixel actually spent by the last render
+
+    static constexpr double ray_t_min = 0.000001;  // Self-intersection offset for every ray
+
+    // First intersection of a camera ray, kept so it can be shaded by several samples.
+    struct primary_hit {
+        ray r;
+        hit_record rec;
+        bool hit;
+    };
 
     void initialize() {
         image_height = static_cast<int>(image_width / aspect_ratio);
@@ -74,8 +230,7 @@ class camera {
 
         // Determine viewport dimensions.
 
-        auto theta = degrees_to_radians(vfov);
-        auto h = tan(theta/2);
+        auto h = tan_degrees(vfov/2);
         auto viewport_height = 2 * h * focus_dist;
         auto viewport_width = viewport_height * (static_cast<double>(image_width)/image_height);
 
@@ -98,7 +253,7 @@ class camera {
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v);
 
         // Calculate the camera defocus disk basis vectors.
-        auto defocus_radius = focus_dist * tan(degrees_to_radians(defocus_angle / 2));
+        auto defocus_radius = focus_dist * tan_degrees(defocus_angle / 2);
         defocus_disk_u = u * defocus_radius;
         defocus_disk_v = v * defocus_radius;
     }
@@ -109,6 +264,254 @@ class camera {
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
+    sampling_settings current_sampling_settings() const {
+        // The settings a checkpoint must share with this camera to be resumed.
+        sampling_settings s;
+        s.samples_per_pixel = samples_per_pixel;
+        s.sampling = sampling;
+        s.jitter = jitter;
+        s.max_depth = max_depth;
+        s.roulette_depth = roulette_depth;
+        s.roulette_threshold = roulette_threshold;
+        s.min_throughput = min_throughput;
+        return s;
+    }
+
+    std::chrono::steady_clock::time_point start_render_stats() const {
+        // Zeroes the RT_STATS counters for a new render and returns its start time.
+#ifdef RT_STATS
+        render_stats_registry::get().reset();
+#endif
+        return std::chrono::steady_clock::now();
+    }
+
+    void report_render_stats(std::chrono::steady_clock::time_point start) const {
+        // RT_STATS builds: logs the counters of the render begun at `start` as JSON, and writes
+        // them to stats_path when one is set.
+#ifdef RT_STATS
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        render_stats totals = render_stats_registry::get().collect();
+        write_render_stats_json(std::clog, totals, elapsed.count());
+        if (!stats_path.empty()) {
+            std::ofstream out(stats_path);
+            if (out)
+                write_render_stats_json(out, totals, elapsed.count());
+            else
+                std::clog << "Could not write stats '" << stats_path << "'\n";
+        }
+#else
+        (void)start;
+#endif
+    }
+
+    void record_tile_time(int x0, int x1, int y0, int y1, std::chrono::steady_clock::time_point start) const {
+        // Adds the wall time since `start` to the tile's pixels in the diagnostics buffers.
+        if (!diagnostics)
+            return;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        diagnostics->add_tile_time(x0, x1, y0, y1, elapsed.count());
+    }
+
+    void for_each_tile(thread_pool& pool, const std::function<void(int, int, int, int)>& fn) const {
+        // Runs fn(x0, x1, y0, y1) for every tile of the image on `pool` and waits for them all.
+        int tiles_x = (image_width + tile_size - 1) / tile_size;
+        int tiles_y = (image_height + tile_size - 1) / tile_size;
+
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                pool.submit([&, tx, ty] {
+                    int x0 = tx * tile_size, x1 = std::min(x0 + tile_size, image_width);
+                    int y0 = ty * tile_size, y1 = std::min(y0 + tile_size, image_height);
+                    fn(x0, x1, y0, y1);
+                });
+            }
+        }
+        pool.wait();
+    }
+
+    long long render_tile(const hittable& world, framebuffer& image, int x0, int x1, int y0, int y1) const {
+        // Renders one tile and returns the number of samples it took.
+        if (wavefront && !adaptive_sampling)
+            return render_tile_wavefront(world, image, x0, x1, y0, y1);
+
+        long long samples = 0;
+        pixel_cost_meter meter;
+        for (int j = y0; j < y1; ++j) {
+            if (packet_primary_rays && !adaptive_sampling) {
+                for (int i = x0; i < x1; i += simd_width) {
+                    int lanes = std::min(simd_width, x1 - i);
+                    color pixel_colors[RT_SIMD_WIDTH];
+                    if (primary_rays_fixed()) {
+                        primary_hit primary[RT_SIMD_WIDTH];
+                        pcg32 lane_rng[RT_SIMD_WIDTH];
+                        trace_primary_packet(world, i, j, lanes, 0, primary, lane_rng);
+                        for (int k = 0; k < lanes; k++)
+                            for (int sample = 0; sample < samples_per_pixel; sample++)
+                                pixel_colors[k] += sample_pixel(world, i + k, j, sample, &primary[k]);
+                    } else {
+                        for (int sample = 0; sample < samples_per_pixel; sample++)
+                            sample_pixel_packet(world, i, j, lanes, sample, pixel_colors);
+                    }
+                    for (int k = 0; k < lanes; k++)
+                        image.set(i + k, j, pixel_colors[k] / samples_per_pixel);
+                    if (diagnostics)
+                        diagnostics->add_span(i, j, lanes, samples_per_pixel, meter.take());
+                }
+                samples += static_cast<long long>(x1 - x0) * samples_per_pixel;
+                continue;
+            }
+
+            for (int i = x0; i < x1; ++i) {
+                int n = 0;
+                color pixel_color(0,0,0);
+                primary_hit storage;
+                const primary_hit* primary = cached_primary(world, i, j, storage);
+
+                if (!adaptive_sampling) {
+                    for (n = 0; n < samples_per_pixel; n++)
+                        pixel_color += sample_pixel(world, i, j, n, primary);
+                } else {
+                    // Welford running mean and variance of the sample luminance. Once the
+                    // minimum is in, the pixel stops as soon as the standard error of its mean
+                    // drops below the threshold (relative to the pixel's brightness, with a floor
+                    // so near-black pixels do not chase noise forever).
+                    double mean = 0, m2 = 0;
+                    while (n < samples_per_pixel) {
+                        color c = sample_pixel(world, i, j, n, primary);
+                        pixel_color += c;
+                        n++;
+
+                        double lum = 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+                        double delta = lum - mean;
+                        mean += delta / n;
+                        m2 += delta * (lum - mean);
+
+                        if (n >= min_samples && n >= 2) {
+                            double std_error = sqrt(m2 / (n - 1) / n);
+                            if (std_error <= adaptive_threshold * fmax(mean, 0.05))
+                                break;
+                        }
+                    }
+                }
+
+                image.set(i, j, pixel_color / n);
+                samples += n;
+                if (diagnostics)
+                    diagnostics->add_pixel(i, j, n, meter.take());
+            }
+        }
+        return samples;
+    }
+
+    color sample_pixel(const hittable& world, int i, int j, int sample,
+                       const primary_hit* primary = nullptr) const {
+        // Traces sample number `sample` of pixel (i,j) and returns its radiance. With a cached
+        // primary hit, only the bounces after it are traced.
+        seed_pixel_sample(seed, i, j, sample);
+        start_pixel_sample(i, j, sample, samples_per_pixel);
+        if (primary)
+            return shade_primary(*primary, world);
+        return ray_color(get_ray(i, j), max_depth, world);
+    }
+
+    bool primary_rays_fixed() const {
+        // Without defocus or jitter, every sample of a pixel starts with the same camera ray
+        // (get_ray draws no random numbers), so its first hit can be computed once.
+        return primary_hit_cache && defocus_angle <= 0 && !jitter;
+    }
+
+    const primary_hit* cached_primary(const hittable& world, int i, int j, primary_hit& storage) const {
+        // Traces pixel (i,j)'s primary ray into `storage` and returns it, or returns null when
+        // primary rays differ between samples and each sample must trace its own.
+        if (!primary_rays_fixed())
+            return nullptr;
+        storage.r = get_ray(i, j);
+        storage.hit = world.hit(storage.r, interval(ray_t_min, infinity), storage.rec);
+        RT_STAT(primary_rays);
+        return &storage;
+    }
+
+    color shade_primary(const primary_hit& primary, const hittable& world) const {
+        if (max_depth <= 0) {
+            RT_STAT(paths_max_depth);
+            return color(0,0,0);
+        }
+        if (!primary.hit) {
+            RT_STAT(paths_escaped);
+            return background(primary.r);
+        }
+        return shade_hit(primary.r, primary.rec, max_depth, world);
+    }
+
+    void trace_primary_packet(const hittable& world, int i0, int j, int lanes, int sample,
+                              primary_hit* primary, pcg32* lane_rng) const {
+        // Traces the camera rays of sample `sample` for pixels i0 .. i0+lanes-1 of row j as one
+        // packet. Each lane's random stream, as left after generating its ray, goes to lane_rng.
+        ray_packet rays;
+        rays.t_min = static_cast<float>(ray_t_min);
+
+        for (int k = 0; k < simd_width; k++) {
+            int i = i0 + std::min(k, lanes - 1);  // Pad a partial packet with its last pixel
+            seed_pixel_sample(seed, i, j, sample);
+            start_pixel_sample(i, j, sample, samples_per_pixel);
+            rays.set(k, get_ray(i, j));
+            lane_rng[k] = thread_rng();
+        }
+
+        packet_hit hits;
+        world.hit_packet(rays, mask_from_bits((1 << lanes) - 1), hits);
+        RT_STAT_ADD(primary_rays, lanes);
+
+        for (int k = 0; k < lanes; k++) {
+            primary[k].r = rays.lanes[k];
+
+            // The packet test ran in float as a conservative filter. A lane it could not decide
+            // (grazing edge, near tie) is traced again in double; otherwise the winning
+            // primitive is redone in double to build the hit record, and if the two still
+            // disagree the lane is traced normally.
+            const ray& r = primary[k].r;
+            hit_record& rec = primary[k].rec;
+            bool hit;
+            if (hits.uncertain & (1 << k)) {
+                RT_STAT(packet_retraces);
+                hit = world.hit(r, interval(ray_t_min, infinity), rec);
+            } else {
+                hit = hits.prim[k] && hits.prim[k]->hit(r, interval(ray_t_min, infinity), rec);
+                if (hits.prim[k] && !hit)
+                    hit = world.hit(r, interval(ray_t_min, infinity), rec);
+            }
+            primary[k].hit = hit;
+        }
+    }
+
+    void sample_pixel_packet(const hittable& world, int i0, int j, int lanes, int sample,
+                             color* pixel_colors) const {
+        // Traces sample `sample` of pixels i0 .. i0+lanes-1 of row j as one packet of camera
+        // rays, then shades each lane on its own. Every lane consumes its random stream in the
+        // same order as sample_pixel(), so both paths render the same image.
+        primary_hit primary[RT_SIMD_WIDTH];
+        pcg32 lane_rng[RT_SIMD_WIDTH];
+        trace_primary_packet(world, i0, j, lanes, sample, primary, lane_rng);
+
+        for (int k = 0; k < lanes; k++) {
+            thread_rng() = lane_rng[k];
+            start_pixel_sample(i0 + k, j, sample, samples_per_pixel);
+            pixel_colors[k] += shade_primary(primary[k], world);
+        }
+    }
+
+    ray get_ray(int i, int j) const {
+        // Construct a camera ray originating from the defocus disk and directed at pixel (i,j).
+        select_sample_dimension(sample_dim_pixel);
+        auto offset = jitter ? sample_square() : vec3(0,0,0);
+        auto pixel_center = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v);
+
+        select_sample_dimension(sample_dim_lens);
+        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+        auto ray_direction = pixel_center - ray_origin;
+        return ray(ray_origin, ray_direction);
+    }
+
     vec3 sample_square() const {
         // Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5] unit square.
         return vec3(random_double() - 0.5, random_double() - 0.5, 0);
@@ -117,20 +520,180 @@ class camera {
     color ray_color(const ray& r, int depth, const hittable& world) const {
         hit_record rec;
 
-        if(depth == 0){
+        if(depth <= 0){
+            RT_STAT(paths_max_depth);
             return color(0,0,0);
         }
 
-        if (world.hit(r, interval(0.000001, infinity), rec)) {
+        RT_STAT(primary_rays);
+        if (world.hit(r, interval(ray_t_min, infinity), rec)) {
+            return shade_hit(r, rec, depth, world);
+        }
+
+        RT_STAT(paths_escaped);
+        return background(r);
+    }
+
+    color shade_hit(ray r, hit_record rec, int depth, const hittable& world) const {
+        // Radiance leaving the surface hit recorded in `rec` back along `r`. The path is followed
+        // bounce by bounce, carrying the product of the attenuations so far, until it escapes to
+        // the background, is absorbed, or `depth` runs out.
+        color throughput(1, 1, 1);
+        for (int bounce = max_depth - depth; ; bounce++) {
             ray scattered;
             color attenuation;
-            if(rec.mat->scatter(r, rec, attenuation, scattered)) {
-                return attenuation * ray_color(scattered, depth - 1, world);
+            select_sample_dimension(sample_dim_bounce + bounce * sample_dims_per_bounce);
+            RT_STAT(scatters[static_cast<int>(rec.mat->kind)]);
+            if (!rec.mat->scatter(r, rec, attenuation, scattered)) {
+                RT_STAT(paths_absorbed);
+                return color(0,0,0);
+            }
+            if (!extend_path(throughput, attenuation, bounce, depth))
+                return color(0,0,0);
+
+            r = scattered;
+            RT_STAT(secondary_rays);
+            if (!world.hit(r, interval(ray_t_min, infinity), rec)) {
+                RT_STAT(paths_escaped);
+                return throughput * background(r);
+            }
+        }
+    }
+
+    bool extend_path(color& throughput, const color& attenuation, int bounce, int& depth) const {
+        // Applies the attenuation of bounce `bounce` to a path and decides whether it goes on.
+        throughput = throughput * attenuation;
+        double strength = fmax(throughput.x(), fmax(throughput.y(), throughput.z()));
+        if (--depth <= 0) {
+            RT_STAT(paths_max_depth);
+            return false;
+        }
+        // Unlike roulette this cutoff is biased: the light the dropped paths would have
+        // gathered is lost, not reweighted onto others. It is independent of roulette_depth;
+        // set min_throughput to 0 for an unbiased render.
+        if (min_throughput > 0 && strength < min_throughput) {
+            RT_STAT(paths_dim);
+            return false;
+        }
+
+        // Russian roulette: past roulette_depth bounces, a path dimmer than roulette_threshold
+        // survives with probability strength / roulette_threshold, and the survivors are
+        // weighted up by its inverse so the expected radiance is unchanged.
+        if (roulette_depth > 0 && bounce + 1 >= roulette_depth && strength < roulette_threshold) {
+            double survival = strength / roulette_threshold;
+            select_sample_dimension(sample_dim_bounce + bounce * sample_dims_per_bounce + 3);
+            if (random_double() >= survival) {
+                RT_STAT(paths_roulette);
+                return false;
+            }
+            throughput = throughput / survival;
+        }
+        return true;
+    }
+
+    long long render_tile_wavefront(const hittable& world, framebuffer& image,
+                                    int x0, int x1, int y0, int y1) const {
+        // render_tile() for wavefront mode: the tile's samples are traced as waves of up to
+        // wavefront_size paths. Every path keeps its own random stream and is summed into its
+        // pixel in sample order, so the image is the one render_tile() makes.
+        int width = x1 - x0;
+        long long total = static_cast<long long>(width) * (y1 - y0) * samples_per_pixel;
+        std::vector<color> radiance(total, color(0,0,0));  // By pixel, then sample
+        path_queue queue;
+
+        for (long long first = 0; first < total; first += std::max(wavefront_size, 1)) {
+            long long last = std::min(total, first + std::max(wavefront_size, 1));
+            queue.clear();
+            for (long long slot = first; slot < last; slot++) {
+                int pixel = static_cast<int>(slot / samples_per_pixel);
+                int sample = static_cast<int>(slot % samples_per_pixel);
+                int i = x0 + pixel % width, j = y0 + pixel / width;
+                seed_pixel_sample(seed, i, j, sample);
+                start_pixel_sample(i, j, sample, samples_per_pixel);
+                ray r = get_ray(i, j);
+                if (max_depth > 0)
+                    queue.add(r, i, j, sample, max_depth, thread_rng(), static_cast<int>(slot));
+                else
+                    RT_STAT(paths_max_depth);
+            }
+
+            for (bool secondary = false; !queue.live.empty(); secondary = true) {
+                if (secondary && sort_secondary_rays)
+                    sort_rays_for_coherence(queue.rays, queue.live);
+                intersect_wave(world, queue, radiance);
+                queue.sort_by_material();
+                scatter_wave<lambertian>(queue, material_kind::lambertian);
+                scatter_wave<metal>(queue, material_kind::metal);
+                scatter_wave<dielectric>(queue, material_kind::dielectric);
+                scatter_wave<material>(queue, material_kind::other);
+            }
+        }
+
+        for (int j = y0; j < y1; ++j) {
+            for (int i = x0; i < x1; ++i) {
+                const color* samples = &radiance[(static_cast<long long>(j - y0) * width + (i - x0)) * samples_per_pixel];
+                color pixel_color(0,0,0);
+                for (int sample = 0; sample < samples_per_pixel; sample++)
+                    pixel_color += samples[sample];
+                image.set(i, j, pixel_color / samples_per_pixel);
+                if (diagnostics)
+                    diagnostics->add_pixel(i, j, samples_per_pixel, pixel_cost());
+            }
+        }
+        return total;
+    }
+
+    void intersect_wave(const hittable& world, path_queue& queue, std::vector<color>& radiance) const {
+        // Intersect stage: traces every live path. Paths that escape take the background and
+        // leave the wave. With diagnostics, each trace's cost goes to the path's pixel.
+        size_t kept = 0;
+        pixel_cost_meter meter;
+        for (int k : queue.live) {
+            if (queue.bounce[k] == 0)
+                RT_STAT(primary_rays);
+            else
+                RT_STAT(secondary_rays);
+            bool hit = world.hit(queue.rays[k], interval(ray_t_min, infinity), queue.hits[k]);
+            if (diagnostics)
+                diagnostics->add_pixel(queue.pixel_x[k], queue.pixel_y[k], 0, meter.take());
+            if (hit) {
+                queue.live[kept++] = k;
             } else {
-                return color(0, 0, 0);
+                RT_STAT(paths_escaped);
+                radiance[queue.slot[k]] = queue.throughput[k] * background(queue.rays[k]);
             }
         }
+        queue.live.resize(kept);
+    }
 
+    template <typename M>
+    void scatter_wave(path_queue& queue, material_kind kind) const {
+        // Scatter stage for the paths that hit a material of kind `kind`, all of type M. Each
+        // path's random stream and sampler position are restored around its scatter, so it
+        // draws the numbers it would have drawn on its own. Absorbed paths keep zero radiance.
+        for (int k : queue.by_material[static_cast<int>(kind)]) {
+            thread_rng() = queue.rng[k];
+            start_pixel_sample(queue.pixel_x[k], queue.pixel_y[k], queue.sample[k], samples_per_pixel);
+
+            int bounce = queue.bounce[k];
+            ray scattered;
+            color attenuation;
+            select_sample_dimension(sample_dim_bounce + bounce * sample_dims_per_bounce);
+            RT_STAT(scatters[static_cast<int>(kind)]);
+            bool scattered_ok = scatter_exact<M>(*queue.hits[k].mat, queue.rays[k], queue.hits[k], attenuation, scattered);
+            if (!scattered_ok)
+                RT_STAT(paths_absorbed);
+            bool alive = scattered_ok && extend_path(queue.throughput[k], attenuation, bounce, queue.depth[k]);
+
+            queue.rng[k] = thread_rng();
+            if (alive) {
+                queue.rays[k] = scattered;
+                queue.bounce[k] = bounce + 1;
+                queue.live.push_back(k);
+            }
+        }
+    }
+    static color background(const ray& r) {
         vec3 unit_direction = unit_vector(r.direction());
         auto a = 0.5*(unit_direction.y() + 1.0);
         return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
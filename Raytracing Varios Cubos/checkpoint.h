@@ -0,0 +1,116 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "framebuffer.h"
+#include "sampler.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// On-disk snapshot of a progressive render: the accumulation buffer plus everything needed to
+// continue its random streams. Since every pixel sample is seeded from (seed, pixel, sample
+// index), the RNG state is fully described by the seed and the next sample index. The sampling
+// settings are stored too, as text: passes rendered with another sample count, sampler, jitter,
+// depth or roulette would average a different estimator into the buffer.
+//
+// Layout (native endianness, so resume on the same kind of machine):
+//   char[8]  magic "RTCKPT1\0"
+//   int32    width, height
+//   uint64   seed
+//   int32    samples accumulated per pixel (= next sample index)
+//   uint32   length of the settings text, then the text itself
+//   double   sum[width * height * 3]
+
+// The camera settings that decide what each sample computes (see camera.h).
+struct sampling_settings {
+    int    samples_per_pixel = 0;  // The samplers stratify over the whole count
+    sampler_type sampling = sampler_type::independent;
+    bool   jitter = false;
+    int    max_depth = 0;
+    int    roulette_depth = 0;
+    double roulette_threshold = 0;
+    double min_throughput = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const sampling_settings& s) {
+    return out << s.samples_per_pixel << " samples per pixel, sampler " << sampler_type_name(s.sampling)
+               << ", jitter " << (s.jitter ? "on" : "off") << ", max depth " << s.max_depth
+               << ", roulette depth " << s.roulette_depth << ", roulette threshold " << s.roulette_threshold
+               << ", min throughput " << s.min_throughput;
+}
+
+inline std::string describe(const sampling_settings& s) {
+    // The text a checkpoint stores; two renders may share a checkpoint only if theirs match.
+    std::ostringstream out;
+    out.precision(17);
+    out << s;
+    return out.str();
+}
+
+struct render_checkpoint {
+    uint64_t seed = 0;
+    std::string settings;  // describe() of the sampling_settings it was rendered with
+    accumulation_buffer accum;
+};
+
+inline bool save_checkpoint(const std::string& path, const render_checkpoint& ckpt) {
+    // Writes to a temporary file and renames it over `path`, so a process killed mid-write
+    // leaves the previous checkpoint intact.
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        const char magic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '1', '\0' };
+        int32_t header[2] = { ckpt.accum.width, ckpt.accum.height };
+        int32_t samples = ckpt.accum.samples;
+        uint32_t settings_length = static_cast<uint32_t>(ckpt.settings.size());
+
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&ckpt.seed), sizeof(ckpt.seed));
+        out.write(reinterpret_cast<const char*>(&samples), sizeof(samples));
+        out.write(reinterpret_cast<const char*>(&settings_length), sizeof(settings_length));
+        out.write(ckpt.settings.data(), static_cast<std::streamsize>(settings_length));
+        out.write(reinterpret_cast<const char*>(ckpt.accum.sum.data()),
+                  static_cast<std::streamsize>(ckpt.accum.sum.size() * sizeof(double)));
+        out.flush();
+        if (!out)
+            return false;
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+inline bool load_checkpoint(const std::string& path, render_checkpoint& ckpt) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    char magic[8];
+    int32_t header[2], samples;
+    uint32_t settings_length;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&ckpt.seed), sizeof(ckpt.seed));
+    in.read(reinterpret_cast<char*>(&samples), sizeof(samples));
+    in.read(reinterpret_cast<char*>(&settings_length), sizeof(settings_length));
+    if (!in || std::memcmp(magic, "RTCKPT1", 8) != 0 || header[0] <= 0 || header[1] <= 0
+        || settings_length > 4096)
+        return false;
+
+    ckpt.settings.resize(settings_length);
+    in.read(&ckpt.settings[0], static_cast<std::streamsize>(settings_length));
+    ckpt.accum.resize(header[0], header[1]);
+    ckpt.accum.samples = samples;
+    in.read(reinterpret_cast<char*>(ckpt.accum.sum.data()),
+            static_cast<std::streamsize>(ckpt.accum.sum.size() * sizeof(double)));
+    return static_cast<bool>(in);
+}
+
+#endif
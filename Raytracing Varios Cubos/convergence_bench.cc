@@ -0,0 +1,283 @@
+#include "rtweekend.h"
+#include "build_info.h"
+#include "bvh4.h"
+#include "bvh_builder.h"
+#include "image_writer.h"
+#include "scenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Convergence benchmark: how fast each renderer configuration approaches the right image, which
+// samples per second alone cannot say (a better sampler or path termination rule wins by
+// needing fewer samples, not by taking them faster).
+//
+// For each scene, a high-spp reference is rendered once and cached as a PFM, named after the scene,
+// size, spp and build configuration (build_config()). A change to the renderer itself also
+// invalidates it; pass -F to render it again. Every candidate configuration then renders
+// progressively, and at regular wall-clock checkpoints its current image is compared with the
+// reference: MSE, relative MSE, and the efficiency 1 / (MSE * time), which is flat for an unbiased
+// renderer and higher for a better one. The results go to a CSV file and to one SVG plot per scene
+// of MSE over time (log-log, where a slope of -1 is ideal).
+//
+// The reference's own noise sets a floor under every MSE, so give it several times the
+// candidates' samples per pixel (the defaults use 8x).
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct scene_entry {
+    const char* name;
+    void (*build)(hittable_list&, camera&);
+};
+
+struct candidate {
+    const char* name;
+    std::function<void(camera&)> setup;  // Changes from the defaults (independent sampler)
+};
+
+struct checkpoint_row {
+    double seconds;
+    int spp;
+    double mse, rel_mse;
+};
+
+static std::vector<candidate> all_candidates() {
+    auto sampler = [](sampler_type type) { return [type](camera& cam) { cam.sampling = type; }; };
+    return {
+        { "independent", sampler(sampler_type::independent) },
+        { "stratified",  sampler(sampler_type::stratified) },
+        { "halton",      sampler(sampler_type::halton) },
+        { "sobol",       sampler(sampler_type::sobol) },
+        { "bluenoise",   sampler(sampler_type::blue_noise) },
+        { "no_roulette", [](camera& cam) { cam.roulette_depth = 0; cam.min_throughput = 0; } },
+    };
+}
+
+static bool read_pfm(const std::string& path, framebuffer& image) {
+    // Reads a little-endian RGB PFM as write_pfm() writes it.
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int width = 0, height = 0;
+    double scale = 0;
+    if (!(in >> magic >> width >> height >> scale) || magic != "PF" || scale >= 0 || width <= 0 || height <= 0)
+        return false;
+    in.get();  // The single whitespace character after the header
+    image.resize(width, height);
+    size_t row = static_cast<size_t>(width) * 3;
+    for (int j = height - 1; j >= 0; --j)
+        in.read(reinterpret_cast<char*>(&image.rgb[j * row]), static_cast<std::streamsize>(row * sizeof(float)));
+    return static_cast<bool>(in);
+}
+
+static void image_error(const framebuffer& image, const framebuffer& reference, double& mse, double& rel_mse) {
+    // Mean over every pixel and channel of the squared error, and of the squared error relative
+    // to the reference value (with a small floor so black pixels do not dominate).
+    double sum = 0, rel_sum = 0;
+    for (size_t k = 0; k < image.rgb.size(); k++) {
+        double d = static_cast<double>(image.rgb[k]) - reference.rgb[k];
+        double r = reference.rgb[k];
+        sum += d * d;
+        rel_sum += d * d / (r * r + 1e-2);
+    }
+    mse = sum / image.rgb.size();
+    rel_mse = rel_sum / image.rgb.size();
+}
+
+static void write_svg_plot(const std::string& path, const std::string& title, const std::vector<std::string>& names,
+                           const std::vector<std::vector<checkpoint_row>>& runs) {
+    // MSE against seconds on log-log axes, one line per candidate.
+    const double w = 720, h = 480, left = 70, right = 170, top = 40, bottom = 50;
+    double t_min = infinity, t_max = 0, e_min = infinity, e_max = 0;
+    for (const auto& run : runs) {
+        for (const auto& row : run) {
+            if (row.seconds <= 0 || row.mse <= 0) continue;
+            t_min = std::min(t_min, row.seconds); t_max = std::max(t_max, row.seconds);
+            e_min = std::min(e_min, row.mse);     e_max = std::max(e_max, row.mse);
+        }
+    }
+    if (t_max <= 0)
+        return;
+    double lt0 = std::floor(std::log10(t_min)), lt1 = std::ceil(std::log10(t_max));
+    double le0 = std::floor(std::log10(e_min)), le1 = std::ceil(std::log10(e_max));
+    lt1 = std::max(lt1, lt0 + 1);
+    le1 = std::max(le1, le0 + 1);
+    auto x = [&](double t) { return left + (std::log10(t) - lt0) / (lt1 - lt0) * (w - left - right); };
+    auto y = [&](double e) { return top + (le1 - std::log10(e)) / (le1 - le0) * (h - top - bottom); };
+
+    static const char* colors[] = { "#1f77b4", "#d62728", "#2ca02c", "#9467bd", "#ff7f0e", "#8c564b", "#e377c2", "#17becf" };
+    std::ofstream out(path);
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << w << "\" height=\"" << h
+        << "\" font-family=\"sans-serif\" font-size=\"12\">\n"
+        << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n"
+        << "<text x=\"" << left << "\" y=\"24\" font-size=\"15\">" << title << ": MSE over wall-clock time</text>\n";
+    for (double p = lt0; p <= lt1; p++) {
+        out << "<line x1=\"" << x(std::pow(10, p)) << "\" y1=\"" << top << "\" x2=\"" << x(std::pow(10, p))
+            << "\" y2=\"" << h - bottom << "\" stroke=\"#ddd\"/>\n"
+            << "<text x=\"" << x(std::pow(10, p)) << "\" y=\"" << h - bottom + 16 << "\" text-anchor=\"middle\">"
+            << std::pow(10, p) << " s</text>\n";
+    }
+    for (double p = le0; p <= le1; p++) {
+        out << "<line x1=\"" << left << "\" y1=\"" << y(std::pow(10, p)) << "\" x2=\"" << w - right
+            << "\" y2=\"" << y(std::pow(10, p)) << "\" stroke=\"#ddd\"/>\n"
+            << "<text x=\"" << left - 6 << "\" y=\"" << y(std::pow(10, p)) + 4 << "\" text-anchor=\"end\">1e"
+            << p << "</text>\n";
+    }
+    out << "<text x=\"" << (left + w - right) / 2 << "\" y=\"" << h - 12 << "\" text-anchor=\"middle\">seconds</text>\n"
+        << "<text x=\"16\" y=\"" << (top + h - bottom) / 2 << "\" transform=\"rotate(-90 16 "
+        << (top + h - bottom) / 2 << ")\" text-anchor=\"middle\">MSE</text>\n";
+
+    for (size_t c = 0; c < runs.size(); c++) {
+        const char* color_name = colors[c % (sizeof(colors) / sizeof(colors[0]))];
+        out << "<polyline fill=\"none\" stroke=\"" << color_name << "\" stroke-width=\"1.5\" points=\"";
+        for (const auto& row : runs[c])
+            if (row.seconds > 0 && row.mse > 0)
+                out << x(row.seconds) << ',' << y(row.mse) << ' ';
+        out << "\"/>\n"
+            << "<text x=\"" << w - right + 12 << "\" y=\"" << top + 16 * (c + 1) << "\" fill=\"" << color_name
+            << "\">" << names[c] << "</text>\n";
+    }
+    out << "</svg>\n";
+}
+
+int main(int argc, char* argv[]) {
+    int width = 200, reference_spp = 2048, samples = 256;
+    double interval_seconds = 0.5, time_limit = 60;
+    std::string scene_list = "cube_field,single_cube", candidate_list, prefix = "convergence";
+    bool fresh_reference = false;
+    for (int k = 1; k < argc; k++) {
+        if (!std::strcmp(argv[k], "-w") && k + 1 < argc)      width = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-R") && k + 1 < argc) reference_spp = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-n") && k + 1 < argc) samples = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-i") && k + 1 < argc) interval_seconds = std::atof(argv[++k]);
+        else if (!std::strcmp(argv[k], "-t") && k + 1 < argc) time_limit = std::atof(argv[++k]);
+        else if (!std::strcmp(argv[k], "-s") && k + 1 < argc) scene_list = argv[++k];
+        else if (!std::strcmp(argv[k], "-c") && k + 1 < argc) candidate_list = argv[++k];
+        else if (!std::strcmp(argv[k], "-o") && k + 1 < argc) prefix = argv[++k];
+        else if (!std::strcmp(argv[k], "-F")) fresh_reference = true;
+        else {
+            std::fprintf(stderr, "Usage: %s [-w width] [-R reference spp] [-n candidate spp] [-i checkpoint seconds]\n"
+                                 "       [-t seconds per candidate] [-s scene,...] [-c candidate,...] [-o output prefix] [-F]\n"
+                                 "  -F  Render the references again instead of reading cached ones\n"
+                                 "Scenes: cube_field single_cube. Candidates: independent stratified halton sobol\n"
+                                 "bluenoise no_roulette (default: all).\n", argv[0]);
+            return 1;
+        }
+    }
+
+    auto listed = [](const std::string& list, const char* name) {
+        return list.empty() || ("," + list + ",").find(std::string(",") + name + ",") != std::string::npos;
+    };
+    const scene_entry scenes[] = { { "cube_field", cube_field_scene }, { "single_cube", single_cube_scene } };
+    std::vector<candidate> candidates;
+    for (const auto& c : all_candidates())
+        if (listed(candidate_list, c.name))
+            candidates.push_back(c);
+
+    std::string csv_path = prefix + ".csv";
+    std::ofstream csv(csv_path);
+    if (!csv) {
+        std::fprintf(stderr, "Cannot open '%s' for writing\n", csv_path.c_str());
+        return 1;
+    }
+    csv << "scene,candidate,seconds,spp,mse,rel_mse,efficiency\n";
+
+    std::streambuf* log = std::clog.rdbuf(nullptr);  // Silence the renderer's progress output
+    for (const auto& scene : scenes) {
+        if (!listed(scene_list, scene.name))
+            continue;
+
+        scene_materials().clear();  // The previous scene's world is gone
+        hittable_list world;
+        camera base;
+        scene.build(world, base);
+        {
+            thread_pool pool(base.num_threads);
+            auto root = bvh_builder(pool).build(world.objects, bvh_build_mode::binned_sah);
+            world = hittable_list(make_shared<bvh4>(*root, world.objects));
+        }
+        base.image_width = width;
+        base.jitter = true;  // Every configuration estimates the same pixel-area integral
+
+        // The reference: independent samples from a seed no candidate uses, so its noise is
+        // uncorrelated with theirs.
+        int height = std::max(1, static_cast<int>(width / base.aspect_ratio));
+        std::string ref_path = prefix + "_" + scene.name + "_ref_" + std::to_string(width) + "x"
+                             + std::to_string(height) + "_" + std::to_string(reference_spp) + "_" + build_config()
+                             + ".pfm";
+        framebuffer reference;
+        if (!fresh_reference && read_pfm(ref_path, reference) && reference.width == width
+            && reference.height == height) {
+            std::printf("%s: reference %s (cached)\n", scene.name, ref_path.c_str());
+        } else {
+            camera cam = base;
+            cam.samples_per_pixel = reference_spp;
+            cam.seed = 0x5eed5eed5eedULL;
+            auto start = std::chrono::steady_clock::now();
+            cam.render(world, reference);
+            std::ofstream out(ref_path, std::ios::binary);
+            write_pfm(out, reference);
+            std::printf("%s: reference %s rendered in %.1f s\n", scene.name, ref_path.c_str(), seconds_since(start));
+        }
+
+        std::vector<std::string> names;
+        std::vector<std::vector<checkpoint_row>> runs;
+        for (const auto& cand : candidates) {
+            camera cam = base;
+            cam.samples_per_pixel = samples;
+            cand.setup(cam);
+
+            // Checkpoints are taken between passes; the time spent measuring is left out of the
+            // candidate's clock.
+            std::vector<checkpoint_row> rows;
+            framebuffer current;
+            double paused = 0, next_checkpoint = interval_seconds;
+            auto start = std::chrono::steady_clock::now();
+            cam.on_pass = [&](const accumulation_buffer& accum) {
+                auto pause_start = std::chrono::steady_clock::now();
+                double elapsed = seconds_since(start) - paused;
+                bool last = accum.samples >= samples || elapsed >= time_limit;
+                if (elapsed >= next_checkpoint || last) {
+                    checkpoint_row row;
+                    row.seconds = elapsed;
+                    row.spp = accum.samples;
+                    accum.resolve(current);
+                    image_error(current, reference, row.mse, row.rel_mse);
+                    rows.push_back(row);
+                    while (next_checkpoint <= elapsed)
+                        next_checkpoint += interval_seconds;
+                }
+                paused += seconds_since(pause_start);
+                return !last;
+            };
+            cam.render_progressive(world, current);
+            if (rows.empty())
+                continue;
+
+            for (const auto& row : rows)
+                csv << scene.name << ',' << cand.name << ',' << row.seconds << ',' << row.spp << ','
+                    << row.mse << ',' << row.rel_mse << ',' << 1 / (row.mse * row.seconds) << '\n';
+            const checkpoint_row& final_row = rows.back();
+            std::printf("  %-12s %4d spp in %7.2f s  MSE %.3e  relMSE %.3e  efficiency %9.1f /s\n", cand.name,
+                        final_row.spp, final_row.seconds, final_row.mse, final_row.rel_mse,
+                        1 / (final_row.mse * final_row.seconds));
+            std::fflush(stdout);
+            names.push_back(cand.name);
+            runs.push_back(rows);
+        }
+
+        std::string plot_path = prefix + "_" + scene.name + ".svg";
+        write_svg_plot(plot_path, scene.name, names, runs);
+        std::printf("  plot: %s\n", plot_path.c_str());
+    }
+    std::clog.rdbuf(log);
+    std::printf("results: %s\n", csv_path.c_str());
+}
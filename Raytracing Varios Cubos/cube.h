@@ -1,8 +1,8 @@
 #ifndef CUBE_H
 #define CUBE_H
 
-#include "hittable_list.h"
 #include "rectangles.h"  // donde estn xy_rect, xz_rect, yz_rect
+#include "scene.h"
 
 class cube : public hittable {
 public:
@@ -13,9 +13,25 @@ public:
         return sides.hit(r, ray_t, rec);
     }
 
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        return sides.intersect(r, ray_t, rec);
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        return sides.occluded(r, ray_t);
+    }
+
+    virtual aabb bounding_box() const override {
+        return aabb(box_min, box_max);
+    }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        sides.hit_packet(rays, active, hits);
+    }
+
 public:
     point3 box_min, box_max;
-    hittable_list sides;  // almacena los 6 rectngulos
+    scene sides;  // almacena los 6 rectngulos por valor: sin punteros ni llamadas virtuales por cara
 };
 
 cube::cube(const point3& p0, const point3& p1, shared_ptr<material> ptr) {
@@ -24,26 +40,26 @@ cube::cube(const point3& p0, const point3& p1, shared_ptr<material> ptr) {
 
     // p0.x() < p1.x(), etc.
     // 1) Caras en X = p0.x() y X = p1.x()
-    sides.add(make_shared<yz_rect>(
+    sides.add(yz_rect(
         p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), ptr
     ));
-    sides.add(make_shared<yz_rect>(
+    sides.add(yz_rect(
         p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), ptr
     ));
 
     // 2) Caras en Y = p0.y() y Y = p1.y()
-    sides.add(make_shared<xz_rect>(
+    sides.add(xz_rect(
         p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), ptr
     ));
-    sides.add(make_shared<xz_rect>(
+    sides.add(xz_rect(
         p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), ptr
     ));
 
     // 3) Caras en Z = p0.z() y Z = p1.z()
-    sides.add(make_shared<xy_rect>(
+    sides.add(xy_rect(
         p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), ptr
     ));
-    sides.add(make_shared<xy_rect>(
+    sides.add(xy_rect(
         p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), ptr
     ));
 }
@@ -0,0 +1,162 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "framebuffer.h"
+#include "hittable.h"
+#include "image_writer.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-pixel cost buffers that show where a render's time goes in the image. The camera fills
+// them when camera::diagnostics points at one. Samples taken and tile wall time are recorded in
+// every build; primitive tests, BVH nodes and bounces are the RT_STATS counters (stats.h) the
+// pixel's samples added up, so they need an RT_STATS build.
+
+// How much of the calling thread's RT_STATS counters some piece of work used.
+struct pixel_cost {
+    double primitive_tests = 0;
+    double bvh_nodes = 0;
+    double bounces = 0;  // Secondary rays traced
+};
+
+class pixel_cost_meter {
+  public:
+    pixel_cost_meter() { last = now(); }
+
+    pixel_cost take() {
+        // Cost since construction or the previous take().
+        pixel_cost current = now(), delta;
+        delta.primitive_tests = current.primitive_tests - last.primitive_tests;
+        delta.bvh_nodes = current.bvh_nodes - last.bvh_nodes;
+        delta.bounces = current.bounces - last.bounces;
+        last = current;
+        return delta;
+    }
+
+  private:
+    static pixel_cost now() {
+        pixel_cost c;
+#ifdef RT_STATS
+        const render_stats& s = thread_stats();
+        c.primitive_tests = static_cast<double>(s.primitive_tests);
+        c.bvh_nodes = static_cast<double>(s.bvh_nodes);
+        c.bounces = static_cast<double>(s.secondary_rays);
+#endif
+        return c;
+    }
+
+    pixel_cost last;
+};
+
+class render_diagnostics {
+  public:
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        size_t n = static_cast<size_t>(w) * h;
+        samples.assign(n, 0.0f);
+        primitive_tests.assign(n, 0.0f);
+        bvh_nodes.assign(n, 0.0f);
+        bounces.assign(n, 0.0f);
+        tile_ms.assign(n, 0.0f);
+    }
+
+    void add_pixel(int i, int j, int n, const pixel_cost& cost) {
+        // Pixel (i,j) took `n` more samples, which cost `cost`. Tiles own their pixels, so
+        // threads never add to the same one.
+        size_t k = static_cast<size_t>(j) * width + i;
+        samples[k] += static_cast<float>(n);
+        primitive_tests[k] += static_cast<float>(cost.primitive_tests);
+        bvh_nodes[k] += static_cast<float>(cost.bvh_nodes);
+        bounces[k] += static_cast<float>(cost.bounces);
+    }
+
+    void add_span(int i0, int j, int lanes, int n, const pixel_cost& cost) {
+        // A packet of pixels i0 .. i0+lanes-1 of row j that was traced together: each took `n`
+        // samples and the cost is shared evenly.
+        pixel_cost share;
+        share.primitive_tests = cost.primitive_tests / lanes;
+        share.bvh_nodes = cost.bvh_nodes / lanes;
+        share.bounces = cost.bounces / lanes;
+        for (int k = 0; k < lanes; k++)
+            add_pixel(i0 + k, j, n, share);
+    }
+
+    void add_tile_time(int x0, int x1, int y0, int y1, double seconds) {
+        // Wall time spent on a tile, written to each of its pixels.
+        for (int j = y0; j < y1; ++j)
+            for (int i = x0; i < x1; ++i)
+                tile_ms[static_cast<size_t>(j) * width + i] += static_cast<float>(seconds * 1000);
+    }
+
+  public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> samples;          // Samples taken
+    std::vector<float> primitive_tests;  // Ray-primitive tests (RT_STATS)
+    std::vector<float> bvh_nodes;        // BVH nodes visited (RT_STATS)
+    std::vector<float> bounces;          // Secondary rays traced (RT_STATS)
+    std::vector<float> tile_ms;          // Milliseconds spent on the pixel's tile
+};
+
+inline color false_color(double t) {
+    // Maps t in [0,1] onto a black - blue - magenta - orange - yellow - white ramp, so cost
+    // reads as heat and neighbouring levels stay distinguishable.
+    static const color ramp[] = {
+        color(0.0, 0.0, 0.0), color(0.1, 0.1, 0.6), color(0.6, 0.1, 0.6),
+        color(0.9, 0.4, 0.1), color(1.0, 0.9, 0.1), color(1.0, 1.0, 1.0)
+    };
+    const int stops = sizeof(ramp) / sizeof(ramp[0]);
+    t = std::min(std::max(t, 0.0), 1.0) * (stops - 1);
+    int k = std::min(static_cast<int>(t), stops - 2);
+    double f = t - k;
+    return (1 - f) * ramp[k] + f * ramp[k + 1];
+}
+
+inline bool write_diagnostic_buffer(const std::string& path_prefix, const std::vector<float>& values,
+                                    int width, int height) {
+    // Writes one buffer twice: <prefix>.pfm with the values themselves (grey), and <prefix>.png
+    // in false colour scaled so the largest value is white.
+    float top = 0;
+    for (float v : values)
+        top = std::max(top, v);
+
+    framebuffer raw(width, height), heat(width, height);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            double v = values[static_cast<size_t>(j) * width + i];
+            raw.set(i, j, color(v, v, v));
+            color c = false_color(top > 0 ? v / top : 0);
+            heat.set(i, j, c * c);  // The PNG writer gamma-encodes with a square root
+        }
+    }
+
+    std::ofstream pfm(path_prefix + ".pfm", std::ios::binary);
+    std::ofstream png(path_prefix + ".png", std::ios::binary);
+    if (!pfm || !png)
+        return false;
+    write_pfm(pfm, raw);
+    write_png(png, heat);
+    std::clog << path_prefix << ".png: max " << top << '\n';
+    return true;
+}
+
+inline bool write_render_diagnostics(const std::string& prefix, const render_diagnostics& d) {
+    // Writes <prefix>_samples, <prefix>_tile_ms and, in RT_STATS builds, <prefix>_primitive_tests,
+    // <prefix>_bvh_nodes and <prefix>_bounces, each as a .pfm and a false-colour .png.
+    bool ok = write_diagnostic_buffer(prefix + "_samples", d.samples, d.width, d.height)
+           && write_diagnostic_buffer(prefix + "_tile_ms", d.tile_ms, d.width, d.height);
+#ifdef RT_STATS
+    ok = ok && write_diagnostic_buffer(prefix + "_primitive_tests", d.primitive_tests, d.width, d.height)
+            && write_diagnostic_buffer(prefix + "_bvh_nodes", d.bvh_nodes, d.width, d.height)
+            && write_diagnostic_buffer(prefix + "_bounces", d.bounces, d.width, d.height);
+#endif
+    return ok;
+}
+
+#endif
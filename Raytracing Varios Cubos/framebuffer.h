@@ -0,0 +1,112 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "vec3.h"
+
+#include <cstdint>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Linear RGB image held as interleaved 32-bit floats, row-major with the top scanline first.
+// The renderer fills it in any order; the writers turn it into a file in a single pass.
+class framebuffer {
+  public:
+    framebuffer() {}
+    framebuffer(int w, int h) { resize(w, h); }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        rgb.assign(static_cast<size_t>(w) * h * 3, 0.0f);
+    }
+
+    void set(int i, int j, const color& c) {
+        float* p = &rgb[(static_cast<size_t>(j) * width + i) * 3];
+        p[0] = static_cast<float>(c.x());
+        p[1] = static_cast<float>(c.y());
+        p[2] = static_cast<float>(c.z());
+    }
+
+    color get(int i, int j) const {
+        const float* p = &rgb[(static_cast<size_t>(j) * width + i) * 3];
+        return color(p[0], p[1], p[2]);
+    }
+
+    void quantize(std::vector<uint8_t>& out) const {
+        // Gamma-2 encodes and quantises every channel to [0,255] with the same mapping as
+        // write_color(): int(256 * clamp(sqrt(v), 0, 0.999)). Runs 16 floats per step with SSE.
+        size_t n = rgb.size();
+        out.resize(n);
+        size_t k = 0;
+
+#ifdef __SSE2__
+        const __m128 zero  = _mm_setzero_ps();
+        const __m128 limit = _mm_set1_ps(0.999f);
+        const __m128 scale = _mm_set1_ps(256.0f);
+        for (; k + 16 <= n; k += 16) {
+            __m128i q[4];
+            for (int v = 0; v < 4; v++) {
+                __m128 x = _mm_loadu_ps(&rgb[k + 4*v]);
+                x = _mm_sqrt_ps(_mm_max_ps(x, zero));
+                x = _mm_min_ps(x, limit);
+                q[v] = _mm_cvttps_epi32(_mm_mul_ps(x, scale));
+            }
+            __m128i lo = _mm_packs_epi32(q[0], q[1]);
+            __m128i hi = _mm_packs_epi32(q[2], q[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[k]), _mm_packus_epi16(lo, hi));
+        }
+#endif
+
+        for (; k < n; k++) {
+            float x = rgb[k] > 0 ? std::sqrt(rgb[k]) : 0.0f;
+            x = x < 0.999f ? x : 0.999f;
+            out[k] = static_cast<uint8_t>(static_cast<int>(256 * x));
+        }
+    }
+
+  public:
+    int width = 0;
+    int height = 0;
+    std::vector<float> rgb;  // 3 floats per pixel, final (averaged) linear color
+};
+
+// Running per-pixel radiance sums for progressive rendering. Every pass adds the same number of
+// samples to every pixel, so one sample count covers the whole buffer.
+class accumulation_buffer {
+  public:
+    accumulation_buffer() {}
+    accumulation_buffer(int w, int h) { resize(w, h); }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        samples = 0;
+        sum.assign(static_cast<size_t>(w) * h * 3, 0.0);
+    }
+
+    void add(int i, int j, const color& c) {
+        double* p = &sum[(static_cast<size_t>(j) * width + i) * 3];
+        p[0] += c.x();
+        p[1] += c.y();
+        p[2] += c.z();
+    }
+
+    void resolve(framebuffer& image) const {
+        // Writes the current per-pixel average into `image`.
+        image.resize(width, height);
+        double scale = samples > 0 ? 1.0 / samples : 0.0;
+        for (size_t k = 0; k < sum.size(); k++)
+            image.rgb[k] = static_cast<float>(sum[k] * scale);
+    }
+
+  public:
+    int width = 0;
+    int height = 0;
+    int samples = 0;          // Samples accumulated into every pixel so far
+    std::vector<double> sum;  // 3 doubles per pixel, row-major
+};
+
+#endif
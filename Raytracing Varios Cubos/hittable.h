@@ -1,6 +1,10 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
+#include "packet.h"
+
+class hittable;
 class material;
 
 class hit_record {
@@ -8,8 +12,9 @@ class hit_record {
         point3 p;
         vec3 normal;
         double t;
-        shared_ptr<material> mat;
+        const material* mat;  // Points into scene_materials()
         bool front_face;
+        const hittable* prim;  // Primitive that produced t (set by intersect())
 
         void set_face_normal(const ray& r, const vec3& outward_normal) {
             // Sets the hit record normal vector.
@@ -22,7 +27,57 @@ class hit_record {
 
 class hittable {
     public:
+        virtual ~hittable() = default;
+
         virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+        // Two-stage form of hit(). intersect() finds the closest hit in ray_t but only sets
+        // rec.t and rec.prim; rec.prim->finalize() then fills in p, normal, front_face and mat.
+        // Aggregates intersect their children and finalise once, for the winner, so candidates
+        // that lose to a closer hit never pay for the shading data. The defaults do the full
+        // work in hit(), so shapes that don't split their test keep working unchanged.
+        virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const {
+            if (!hit(r, ray_t, rec))
+                return false;
+            rec.prim = this;
+            return true;
+        }
+
+        virtual void finalize(const ray&, hit_record&) const {}
+
+        // Any-hit query for visibility (shadow, ambient occlusion) rays: true as soon as some
+        // hit in ray_t is found, with no closest-hit search and no hit_record to fill. The
+        // default is intersect(), which is already minimal for single primitives; aggregates
+        // override it to stop at the first hit and skip their near-to-far ordering.
+        virtual bool occluded(const ray& r, interval ray_t) const {
+            hit_record rec;
+            return intersect(r, ray_t, rec);
+        }
+
+        virtual aabb bounding_box() const = 0;
+
+        // Intersects the active lanes of a ray packet, updating each lane's closest t and the
+        // primitive that produced it. The default traces the lanes one by one through hit();
+        // primitives and aggregates override it with vectorised tests.
+        virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const;
+
+    protected:
+        bool intersect_and_finalize(const ray& r, interval ray_t, hit_record& rec) const {
+            // hit() for classes that override intersect() and finalize().
+            if (!intersect(r, ray_t, rec))
+                return false;
+            rec.prim->finalize(r, rec);
+            return true;
+        }
 };
 
+void hittable::hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const {
+    for (int b = bits(active); b; b &= b - 1) {
+        int k = packet_hit::lowest_lane(b);
+        hit_record rec;
+        if (intersect(rays.lanes[k], interval(rays.t_min, hits.t[k] + packet_slack(hits.t[k])), rec))
+            hits.record_lane(k, static_cast<float>(rec.t), rec.prim);
+    }
+}
+
 #endif
\ No newline at end of file
@@ -10,22 +10,47 @@ class hittable_list : public hittable {
         hittable_list() {}
         hittable_list(shared_ptr<hittable> object) { add(object); }
 
-        void clear() { objects.clear(); }
-        void add(shared_ptr<hittable> object) { objects.push_back(object); }
+        void clear() { objects.clear(); bbox = aabb(); }
 
-        virtual bool hit(
+        void add(shared_ptr<hittable> object) {
+            objects.push_back(object);
+            bbox = aabb(bbox, object->bounding_box());
+        }
+
+        virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return intersect_and_finalize(r, ray_t, rec);
+        }
+
+        virtual bool intersect(
             const ray& r, interval ray_t, hit_record& rec) const override;
 
+        virtual bool occluded(const ray& r, interval ray_t) const override {
+            for (const auto& object : objects)
+                if (object->occluded(r, ray_t))
+                    return true;
+            return false;
+        }
+
+        virtual aabb bounding_box() const override { return bbox; }
+
+        virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+            for (const auto& object : objects)
+                object->hit_packet(rays, active, hits);
+        }
+
     public:
         std::vector<shared_ptr<hittable>> objects;
+
+    private:
+        aabb bbox;
 };
 
-bool hittable_list::hit(const ray& r, interval ray_t, hit_record& rec) const {
+bool hittable_list::intersect(const ray& r, interval ray_t, hit_record& rec) const {
     bool hit_anything = false;
     auto closest_so_far = ray_t.max;
 
     for (const auto& object : objects) {
-        if (object->hit(r, interval(ray_t.min, closest_so_far), rec)) {
+        if (object->intersect(r, interval(ray_t.min, closest_so_far), rec)) {
             hit_anything = true;
             closest_so_far = rec.t;
         }
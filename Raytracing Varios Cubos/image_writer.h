@@ -0,0 +1,177 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Writers that turn a finished framebuffer into an image file in one pass. The 8-bit formats
+// share framebuffer::quantize(); PFM stores the linear floats untouched.
+
+enum class image_format { ppm_ascii, ppm, png, pfm };
+
+inline bool parse_image_format(const std::string& name, image_format& format) {
+    if (name == "p3")               { format = image_format::ppm_ascii; return true; }
+    if (name == "ppm" || name == "p6") { format = image_format::ppm; return true; }
+    if (name == "png")              { format = image_format::png; return true; }
+    if (name == "pfm")              { format = image_format::pfm; return true; }
+    return false;
+}
+
+inline bool image_format_from_path(const std::string& path, image_format& format) {
+    // Picks the format from a file name's extension, if it has a known one.
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    return parse_image_format(path.substr(dot + 1), format);
+}
+
+inline void write_ppm_ascii(std::ostream& out, const framebuffer& image) {
+    // Plain-text P3, the format the renderer used to stream pixel by pixel.
+    std::vector<uint8_t> bytes;
+    image.quantize(bytes);
+
+    std::string text;
+    text.reserve(bytes.size() * 4 + 32);
+    text += "P3\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n";
+    for (size_t k = 0; k < bytes.size(); k += 3) {
+        text += std::to_string(bytes[k]);     text += ' ';
+        text += std::to_string(bytes[k + 1]); text += ' ';
+        text += std::to_string(bytes[k + 2]); text += '\n';
+    }
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+inline void write_ppm(std::ostream& out, const framebuffer& image) {
+    // Binary P6: a short header followed by the raw 8-bit RGB triplets.
+    std::vector<uint8_t> bytes;
+    image.quantize(bytes);
+
+    out << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+inline void write_pfm(std::ostream& out, const framebuffer& image) {
+    // Portable float map: linear RGB floats, little-endian (negative scale), bottom row first.
+    out << "PF\n" << image.width << ' ' << image.height << "\n-1.0\n";
+    size_t row = static_cast<size_t>(image.width) * 3;
+    for (int j = image.height - 1; j >= 0; --j) {
+        const float* p = &image.rgb[j * row];
+        out.write(reinterpret_cast<const char*>(p), static_cast<std::streamsize>(row * sizeof(float)));
+    }
+}
+
+namespace png_detail {
+
+inline uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void put_u32(std::vector<uint8_t>& v, uint32_t x) {
+    v.push_back(static_cast<uint8_t>(x >> 24));
+    v.push_back(static_cast<uint8_t>(x >> 16));
+    v.push_back(static_cast<uint8_t>(x >> 8));
+    v.push_back(static_cast<uint8_t>(x));
+}
+
+inline void write_chunk(std::ostream& out, const char* type, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> chunk;
+    chunk.reserve(payload.size() + 12);
+    put_u32(chunk, static_cast<uint32_t>(payload.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), payload.begin(), payload.end());
+    put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+}
+
+} // namespace png_detail
+
+inline void write_png(std::ostream& out, const framebuffer& image) {
+    // 8-bit RGB PNG with no external dependencies. The zlib stream uses stored (uncompressed)
+    // deflate blocks: the file is about as large as a P6, but writing it costs only a copy and
+    // a checksum, and any viewer can open it.
+    using namespace png_detail;
+
+    std::vector<uint8_t> bytes;
+    image.quantize(bytes);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<uint8_t> header;
+    put_u32(header, static_cast<uint32_t>(image.width));
+    put_u32(header, static_cast<uint32_t>(image.height));
+    header.push_back(8);  // Bit depth
+    header.push_back(2);  // Color type: truecolor RGB
+    header.push_back(0);  // Compression: deflate
+    header.push_back(0);  // Filter method 0
+    header.push_back(0);  // No interlace
+    write_chunk(out, "IHDR", header);
+
+    // Raw scanlines, each prefixed with filter type 0 (none).
+    size_t row = static_cast<size_t>(image.width) * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((row + 1) * image.height);
+    for (int j = 0; j < image.height; ++j) {
+        raw.push_back(0);
+        raw.insert(raw.end(), bytes.begin() + j * row, bytes.begin() + (j + 1) * row);
+    }
+
+    std::vector<uint8_t> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);  // Deflate, 32K window
+    zlib.push_back(0x01);  // No preset dictionary, fastest level
+
+    uint32_t adler_a = 1, adler_b = 0;
+    size_t pos = 0;
+    do {
+        size_t len = raw.size() - pos;
+        if (len > 65535) len = 65535;
+        bool last = (pos + len == raw.size());
+
+        zlib.push_back(last ? 1 : 0);  // BFINAL bit, BTYPE 00 (stored)
+        zlib.push_back(static_cast<uint8_t>(len));
+        zlib.push_back(static_cast<uint8_t>(len >> 8));
+        zlib.push_back(static_cast<uint8_t>(~len));
+        zlib.push_back(static_cast<uint8_t>(~len >> 8));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+
+        for (size_t k = pos; k < pos + len; k++) {
+            adler_a = (adler_a + raw[k]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+        pos += len;
+    } while (pos < raw.size());
+    put_u32(zlib, (adler_b << 16) | adler_a);
+
+    write_chunk(out, "IDAT", zlib);
+    write_chunk(out, "IEND", std::vector<uint8_t>());
+}
+
+inline void write_image(std::ostream& out, const framebuffer& image, image_format format) {
+    switch (format) {
+        case image_format::ppm_ascii: write_ppm_ascii(out, image); break;
+        case image_format::ppm:       write_ppm(out, image);       break;
+        case image_format::png:       write_png(out, image);       break;
+        case image_format::pfm:       write_pfm(out, image);       break;
+    }
+}
+
+#endif
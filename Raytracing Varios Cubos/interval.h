@@ -9,6 +9,16 @@ class interval {
 
     interval(double _min, double _max) : min(_min), max(_max) {}
 
+    interval(const interval& a, const interval& b) {
+        // Create the interval tightly enclosing the two input intervals.
+        min = a.min <= b.min ? a.min : b.min;
+        max = a.max >= b.max ? a.max : b.max;
+    }
+
+    double size() const {
+        return max - min;
+    }
+
     bool contains(double x) const {
         return min <= x && x <= max;
     }
@@ -23,6 +33,11 @@ class interval {
         return x;
     }
 
+    interval expand(double delta) const {
+        auto padding = delta/2;
+        return interval(min - padding, max + padding);
+    }
+
     static const interval empty, universe;
 };
 
@@ -1,125 +1,136 @@
 #include "rtweekend.h"
 #include "camera.h"
 #include "hittable_list.h"
-#include "cube.h"
-#include "material.h"
+#include "bvh4.h"
+#include "bvh_builder.h"
+#include "scenes.h"
+#include "image_writer.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <vector>
 
-int main() {
-    hittable_list world;
-
-    // Piso: un cubo gigante que simula un plano
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<cube>(
-        point3(-1000, -1, -1000),
-        point3(1000, 0, 1000),
-        ground_material
-    ));
-
-    // Centros de cubos especiales para evitar colisiones:
-    // Cubo dielctrico: de (-1,0,-1) a (1,2,1) => centro (0,1,0), medio lado = 1.
-    // Cubo difuso: de (-4,0,-1) a (-2,2,1) => centro (-3,1,0), medio lado = 1.
-    // Cubo metlico: de (4,0,-1) a (6,2,1) => centro (5,1,0), medio lado = 1.
-    std::vector<point3> specialCenters;
-    specialCenters.push_back(point3(0, 1, 0));
-    specialCenters.push_back(point3(-3, 1, 0));
-    specialCenters.push_back(point3(5, 1, 0));
-
-    // Vector para almacenar los centros de los cubos pequeos ya colocados
-    std::vector<point3> placedCenters;
-
-    // Bucle similar al original, con muchos pequeos cubos
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+static void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [-o <file>] [-f p3|ppm|png|pfm] [-p] [-c <file>] [-r] [-b sweep|binned|lbvh]\n"
+              << "       [-s independent|stratified|halton|sobol|bluenoise] [-j] [-w] [-t <n>] [-S <file>] [-d <prefix>]\n"
+              << "  -o <file>  Write the image to <file> instead of stdout\n"
+              << "  -f <fmt>   Output format (default: from the file extension, else binary ppm)\n"
+              << "  -p         Progressive rendering in passes\n"
+              << "  -c <file>  Progressive: checkpoint the accumulation buffer to <file>\n"
+              << "  -r         Progressive: resume from the checkpoint given with -c\n"
+              << "  -b <mode>  BVH builder: serial SAH sweep, parallel binned SAH (default) or LBVH\n"
+              << "  -s <type>  Sampler for pixel, lens and bounce random numbers (default: independent)\n"
+              << "  -j         Jitter samples within their pixel (antialiasing)\n"
+              << "  -w         Wavefront mode: trace each tile's paths in waves, one stage at a time\n"
+              << "  -t <n>     Render on <n> threads (default: all hardware threads); the image is the same\n"
+              << "  -S <file>  RT_STATS builds: write the render counters to <file> as JSON\n"
+              << "  -d <name>  Write per-pixel cost heatmaps to <name>_<buffer>.png and .pfm\n";
+}
 
-            // Evitamos colisiones con cubos especiales
-            bool collides = false;
-            for (const auto& sp_center : specialCenters) {
-                if (std::fabs(center.x() - sp_center.x()) < 1.2 &&
-                    std::fabs(center.z() - sp_center.z()) < 1.2) {
-                    collides = true;
-                    break;
-                }
-            }
-            // Evitar colisiones con cubos pequeos ya colocados (lado 0.4 => separacin mnima en x y z: 0.4)
-            for (const auto& placed : placedCenters) {
-                if (std::fabs(center.x() - placed.x()) < 0.4 &&
-                    std::fabs(center.z() - placed.z()) < 0.4) {
-                    collides = true;
-                    break;
-                }
-            }
-            if (collides) continue;
+int main(int argc, char* argv[]) {
+    std::string out_path;
+    image_format format = image_format::ppm;
+    bool format_given = false;
+    bool progressive = false;
+    bool resume = false;
+    std::string checkpoint_path;
+    bvh_build_mode build_mode = bvh_build_mode::binned_sah;
+    sampler_type sampling = sampler_type::independent;
+    bool jitter = false;
+    bool wavefront = false;
+    std::string stats_path;
+    std::string diagnostics_prefix;
+    int threads = 0;
 
-            // Asignar materiales con probabilidad igual (1/3 cada uno)
-            shared_ptr<material> cube_material;
-            if (choose_mat < 1.0 / 3) {
-                // Difuso
-                auto albedo = color::random() * color::random();
-                cube_material = make_shared<lambertian>(albedo);
+    for (int k = 1; k < argc; k++) {
+        if (!std::strcmp(argv[k], "-o") && k + 1 < argc) {
+            out_path = argv[++k];
+        } else if (!std::strcmp(argv[k], "-f") && k + 1 < argc) {
+            if (!parse_image_format(argv[++k], format)) {
+                std::cerr << "Unknown image format '" << argv[k] << "'\n";
+                return 1;
             }
-            else if (choose_mat < 2.0 / 3) {
-                // Metlico
-                auto albedo = color::random(0.5, 1);
-                auto fuzz = random_double(0, 0.5);
-                cube_material = make_shared<metal>(albedo, fuzz);
+            format_given = true;
+        } else if (!std::strcmp(argv[k], "-p")) {
+            progressive = true;
+        } else if (!std::strcmp(argv[k], "-c") && k + 1 < argc) {
+            checkpoint_path = argv[++k];
+            progressive = true;
+        } else if (!std::strcmp(argv[k], "-r")) {
+            resume = true;
+            progressive = true;
+        } else if (!std::strcmp(argv[k], "-b") && k + 1 < argc) {
+            if (!parse_bvh_build_mode(argv[++k], build_mode)) {
+                std::cerr << "Unknown BVH builder '" << argv[k] << "'\n";
+                return 1;
             }
-            else {
-                // Dielctrico (vidrio)
-                cube_material = make_shared<dielectric>(1.5);
+        } else if (!std::strcmp(argv[k], "-s") && k + 1 < argc) {
+            if (!parse_sampler_type(argv[++k], sampling)) {
+                std::cerr << "Unknown sampler '" << argv[k] << "'\n";
+                return 1;
             }
-            // Crear el cubo pequeo (lado = 0.4, extendido 0.2 en cada direccin)
-            world.add(make_shared<cube>(
-                center - vec3(0.2, 0.2, 0.2),
-                center + vec3(0.2, 0.2, 0.2),
-                cube_material
-            ));
-            placedCenters.push_back(center);
+        } else if (!std::strcmp(argv[k], "-j")) {
+            jitter = true;
+        } else if (!std::strcmp(argv[k], "-w")) {
+            wavefront = true;
+        } else if (!std::strcmp(argv[k], "-t") && k + 1 < argc) {
+            threads = std::atoi(argv[++k]);
+        } else if (!std::strcmp(argv[k], "-S") && k + 1 < argc) {
+            stats_path = argv[++k];
+        } else if (!std::strcmp(argv[k], "-d") && k + 1 < argc) {
+            diagnostics_prefix = argv[++k];
+        } else {
+            usage(argv[0]);
+            return 1;
         }
     }
+    if (!format_given && !out_path.empty())
+        image_format_from_path(out_path, format);
 
-    // Cubos especiales para ver claramente los materiales:
-
-    // Cubo dielctrico (vidrio)
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<cube>(
-        point3(-1, 0, -1),
-        point3(1, 2, 1),
-        material1
-    ));
-
-    // Cubo difuso
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<cube>(
-        point3(-4, 0, -1),
-        point3(-2, 2, 1),
-        material2
-    ));
-
-    // Cubo metlico
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<cube>(
-        point3(4, 0, -1),
-        point3(6, 2, 1),
-        material3
-    ));
+    hittable_list world;
 
-    // Configuracin de la cmara
     camera cam;
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width = 500;
-    cam.samples_per_pixel = 50;
-    cam.max_depth = 25;
+    cube_field_scene(world, cam);
+    cam.sampling = sampling;
+    cam.jitter = jitter;
+    cam.wavefront = wavefront;
+    cam.num_threads = threads;
+    cam.stats_path = stats_path;
+    render_diagnostics diagnostics;
+    if (!diagnostics_prefix.empty())
+        cam.diagnostics = &diagnostics;
 
-    cam.vfov = 20;
-    cam.lookfrom = point3(13, 2, 3);
-    cam.lookat = point3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    {
+        thread_pool pool(cam.num_threads);
+        bvh_build_stats stats;
+        auto root = bvh_builder(pool).build(world.objects, build_mode, &stats);
+        std::clog << "BVH: " << stats.seconds * 1000 << " ms, SAH cost " << stats.sah_cost
+                  << ", " << stats.interior_nodes << " nodes, " << stats.leaves << " leaves\n";
+        world = hittable_list(make_shared<bvh4>(*root, world.objects));
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    framebuffer image;
+    if (progressive) {
+        cam.checkpoint_path = checkpoint_path;
+        if (!cam.render_progressive(world, image, resume))
+            return 1;
+    } else {
+        cam.render(world, image);
+    }
 
-    cam.render(world);
+    if (out_path.empty()) {
+        write_image(std::cout, image, format);
+    } else {
+        std::ofstream out(out_path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Cannot open '" << out_path << "' for writing\n";
+            return 1;
+        }
+        write_image(out, image, format);
+    }
+
+    if (cam.diagnostics && !write_render_diagnostics(diagnostics_prefix, diagnostics)) {
+        std::cerr << "Cannot write the diagnostics to '" << diagnostics_prefix << "_*'\n";
+        return 1;
+    }
 }
@@ -3,18 +3,31 @@
 
 #include "rtweekend.h"
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 class hit_record;
 
+// Concrete type of a material, so code that processes many hits at once (the wavefront
+// renderer) can group them by material and call each scatter() without virtual dispatch.
+enum class material_kind { lambertian, metal, dielectric, other };
+
+const int material_kind_count = 4;
+
 class material {
   public:
+    explicit material(material_kind k = material_kind::other) : kind(k) {}
     virtual ~material() = default;
 
     virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
+
+    const material_kind kind;
 };
 
 class lambertian : public material {
   public:
-    lambertian(const color& a) : albedo(a) {}
+    lambertian(const color& a) : material(material_kind::lambertian), albedo(a) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
     const override {
@@ -35,7 +48,7 @@ class lambertian : public material {
 
 class metal : public material {
   public:
-    metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+    metal(const color& a, double f) : material(material_kind::metal), albedo(a), fuzz(f < 1 ? f : 1) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
     const override {
@@ -52,7 +65,7 @@ class metal : public material {
 
 class dielectric : public material {
   public:
-    dielectric(double index_of_refraction) :ir(index_of_refraction) {}
+    dielectric(double index_of_refraction) : material(material_kind::dielectric), ir(index_of_refraction) {}
 
     bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override {
         vec3 unit_direction = unit_vector(r_in.direction());
@@ -81,8 +94,54 @@ class dielectric : public material {
       // Use Schlick's approximation for reflectance.
       auto r0 = (1 - refraction_index) / (1 + refraction_index);
       r0 = r0*r0;
-      return r0 + (1-r0)*pow((1 - cosine),5);
+      auto x = 1 - cosine;
+      auto x2 = x*x;
+      return r0 + (1-r0)*x2*x2*x;
+    }
+};
+
+// Flat, append-only store that owns every material in the scene. Primitives and hit records
+// refer to materials by raw pointer into this table, so recording a hit never touches a
+// shared_ptr reference count.
+class material_table {
+  public:
+    const material* add(shared_ptr<material> m) {
+        // Returns the table's pointer for `m`, registering it on first use. Materials shared by
+        // many primitives (all six faces of a cube, say) are stored once.
+        if (!m) return nullptr;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(m.get());
+        if (found != index.end())
+            return materials[found->second].get();
+
+        index.emplace(m.get(), materials.size());
+        materials.push_back(m);
+        return m.get();
+    }
+
+    void clear() {
+        // Releases every material. Only once no primitive built from the table is left.
+        std::lock_guard<std::mutex> lock(mutex);
+        materials.clear();
+        index.clear();
     }
+
+    size_t size() const { return materials.size(); }
+    const material* operator[](size_t i) const { return materials[i].get(); }
+
+  private:
+    std::mutex mutex;
+    std::vector<shared_ptr<material>> materials;
+    std::unordered_map<const material*, size_t> index;
 };
 
+inline material_table& scene_materials() {
+    // The table every primitive registers its material with. add() is locked, so scenes may be
+    // built on several threads at once, but they then share the table; a program that builds
+    // one scene after another calls clear() once the previous scene is destroyed, or the
+    // materials of every scene pile up until exit.
+    static material_table table;
+    return table;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "rtweekend.h"
+
+#include "simd.h"
+
+class hittable;
+
+// The packet tests run in float on rays and bounds converted from double, so they only filter:
+// bounds are rounded or padded outwards so no double hit is lost, and a lane whose float
+// result is too close to call (a grazing edge, a distance less accurate than packet_slack, or
+// two hits within packet_slack of each other) is marked uncertain in packet_hit and traced
+// again in double.
+
+inline float float_round_down(double v) {
+    // The largest float not above v.
+    float f = static_cast<float>(v);
+    return f > v ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+inline float float_round_up(double v) {
+    // The smallest float not below v.
+    float f = static_cast<float>(v);
+    return f < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+inline float packet_pad(double v) {
+    // Padding of a float bound, relative to the coordinate's magnitude.
+    return static_cast<float>(1e-5 * (1.0 + std::fabs(v)));
+}
+
+// Two float distances closer than this cannot be ordered with confidence.
+inline float packet_slack(float t) { return 1e-4f * (1.0f + t); }
+inline vfloat packet_slack(vfloat t) { return vfloat(1e-4f) * (vfloat(1.0f) + t); }
+
+// A bundle of simd_width coherent rays (neighbouring camera rays) in structure-of-arrays form,
+// so each intersection test handles every lane with one stream of vector instructions. The
+// float copies drive the packet tests; the original double rays are kept for shading.
+struct alignas(32) ray_packet {
+    float o[3][RT_SIMD_WIDTH];      // Origin, per axis and lane
+    float d[3][RT_SIMD_WIDTH];      // Direction, per axis and lane
+    float inv_d[3][RT_SIMD_WIDTH];  // 1 / direction, per axis and lane
+    float err_o[3][RT_SIMD_WIDTH];  // The origin's share of plane_t_error(), per axis and lane
+    float err_k[3][RT_SIMD_WIDTH];  // Share of plane_t_error() per unit of 1 + |k|
+    float err_o_sum[RT_SIMD_WIDTH]; // err_o and err_k summed over the axes, per lane
+    float err_k_sum[RT_SIMD_WIDTH];
+    float t_min;
+    ray   lanes[RT_SIMD_WIDTH];
+
+    void set(int lane, const ray& r) {
+        lanes[lane] = r;
+        for (int axis = 0; axis < 3; axis++) {
+            o[axis][lane] = static_cast<float>(r.origin()[axis]);
+            d[axis][lane] = static_cast<float>(r.direction()[axis]);
+            inv_d[axis][lane] = 1.0f / d[axis][lane];
+            // Capped, so a ray exactly parallel to an axis still compares as a miss (and a zero
+            // origin times an infinite inverse, NaN, takes the cap too).
+            float e_k = 4e-7f * std::fabs(inv_d[axis][lane]);
+            float e_o = e_k * std::fabs(o[axis][lane]);
+            err_k[axis][lane] = e_k < 1e30f ? e_k : 1e30f;
+            err_o[axis][lane] = e_o < 1e30f ? e_o : 1e30f;
+        }
+        err_o_sum[lane] = err_o[0][lane] + err_o[1][lane] + err_o[2][lane];
+        err_k_sum[lane] = err_k[0][lane] + err_k[1][lane] + err_k[2][lane];
+    }
+
+    vfloat origin(int axis) const    { return vfloat::load(o[axis]); }
+    vfloat direction(int axis) const { return vfloat::load(d[axis]); }
+    vfloat inv_direction(int axis) const { return vfloat::load(inv_d[axis]); }
+
+    vfloat plane_t_error(int axis, float k) const {
+        // Bound on the error of a float t = (k - o) * inv_d for the plane at `k` on `axis`, from
+        // rounding the coordinates: a few ulps of |k| and |o|, stretched by |inv_d| as the ray
+        // turns parallel to the plane. Its own relative rounding is left to packet_slack.
+        return vfloat::load(err_o[axis]) + vfloat(1.0f + std::fabs(k)) * vfloat::load(err_k[axis]);
+    }
+
+    vfloat slab_t_error(float k) const {
+        // plane_t_error() summed over the three axes, for planes no farther than |k| from 0: a
+        // bound on the error of any slab distance, without knowing which axis set it.
+        return vfloat::load(err_o_sum) + vfloat(1.0f + k) * vfloat::load(err_k_sum);
+    }
+};
+
+// Closest hit found so far for each lane of a packet. Only the distance and the primitive are
+// tracked; the full hit_record is computed afterwards, in double precision, for the winner.
+struct alignas(32) packet_hit {
+    float t[RT_SIMD_WIDTH];
+    float limit[RT_SIMD_WIDTH];  // t + packet_slack(t), kept up to date by record()
+    const hittable* prim[RT_SIMD_WIDTH];
+    int uncertain = 0;  // Bit per lane: the float tests could not tell the closest hit apart
+
+    packet_hit() {
+        for (int k = 0; k < RT_SIMD_WIDTH; k++) {
+            t[k] = limit[k] = std::numeric_limits<float>::infinity();
+            prim[k] = nullptr;
+        }
+    }
+
+    vfloat t_max() const { return vfloat::load(t); }
+
+    // How far a test must look: hits just past t_max are close calls that record() flags.
+    vfloat t_limit() const { return vfloat::load(limit); }
+
+    void record(vmask hit, vfloat t_hit, const hittable* object) {
+        // Stores t_hit and `object` for every lane set in `hit` that is closer than the lane's
+        // current hit. A hit within packet_slack of the current one, either side, makes the
+        // lane uncertain.
+        vfloat best = t_max(), slack = packet_slack(best);
+        vmask closer = hit & (t_hit < best);
+        mark_uncertain(hit & (t_hit > best - slack) & (t_hit < best + slack));
+        int b = bits(closer);
+        if (!b)
+            return;
+        vfloat nearest = select(closer, t_hit, best);
+        nearest.store(t);
+        (nearest + packet_slack(nearest)).store(limit);
+        for (; b; b &= b - 1)
+            prim[lowest_lane(b)] = object;
+    }
+
+    void record_lane(int k, float t_hit, const hittable* object) {
+        // record() for a single lane.
+        float slack = packet_slack(t[k]);
+        if (t_hit > t[k] - slack && t_hit < t[k] + slack)
+            uncertain |= 1 << k;
+        if (t_hit < t[k]) {
+            t[k] = t_hit;
+            limit[k] = t_hit + packet_slack(t_hit);
+            prim[k] = object;
+        }
+    }
+
+    void mark_uncertain(vmask lanes) { uncertain |= bits(lanes); }
+
+    static int lowest_lane(int b) {
+        int k = 0;
+        while (!(b & (1 << k))) k++;
+        return k;
+    }
+};
+
+inline vmask aabb_hit_packet(const float* lo, const float* hi, const ray_packet& rays, vmask active,
+                             const packet_hit& hits) {
+    // Slab test of every active lane against one box, given as float bounds that contain the
+    // double box; lanes already holding a closer hit than the box's entry point are dropped.
+    vfloat t_near(rays.t_min), t_far = hits.t_limit();
+    for (int axis = 0; axis < 3; axis++) {
+        vfloat inv = rays.inv_direction(axis), orig = rays.origin(axis);
+        vfloat t0 = (vfloat(lo[axis]) - orig) * inv;
+        vfloat t1 = (vfloat(hi[axis]) - orig) * inv;
+        t_near = vmax(t_near, vmin(t0, t1));
+        t_far  = vmin(t_far,  vmax(t0, t1));
+    }
+    return active & (t_near <= t_far + packet_slack(vmax(t_far, vfloat(0.0f))));
+}
+
+inline vmask aabb_hit_packet(const interval& x, const interval& y, const interval& z,
+                             const ray_packet& rays, vmask active, const packet_hit& hits) {
+    // The same for a double box, its bounds rounded outwards to float.
+    float lo[3] = { float_round_down(x.min), float_round_down(y.min), float_round_down(z.min) };
+    float hi[3] = { float_round_up(x.max), float_round_up(y.max), float_round_up(z.max) };
+    return aabb_hit_packet(lo, hi, rays, active, hits);
+}
+
+#endif
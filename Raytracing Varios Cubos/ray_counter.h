@@ -0,0 +1,86 @@
+#ifndef RAY_COUNTER_H
+#define RAY_COUNTER_H
+
+#include "hittable.h"
+#include "packet.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Counts the rays a render traces: every hit() call on the world is one ray, and a packet
+// counts its active lanes. A lane the packet test leaves uncertain is not counted there: the
+// camera traces it again with hit(), which counts it. Wrap the world in it to get Mrays/s from
+// any build.
+//
+// As with the RT_STATS blocks (stats.h), each thread counts into a slot of its own, on its own
+// cache line, so tracing never contends on a shared counter; rays() adds the slots up. Call it
+// while no thread is tracing (after the render).
+class ray_counter final : public hittable {
+  public:
+    explicit ray_counter(const hittable& world) : world(world), id(next_id()) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        local_slot().rays++;
+        return world.hit(r, ray_t, rec);
+    }
+
+    bool occluded(const ray& r, interval ray_t) const override {
+        local_slot().rays++;
+        return world.occluded(r, ray_t);
+    }
+
+    void hit_packet(const ray_packet& packet, vmask active, packet_hit& hits) const override {
+        int uncertain = hits.uncertain;
+        world.hit_packet(packet, active, hits);
+        int retraced = hits.uncertain & ~uncertain & bits(active);
+        local_slot().rays += lane_count(active) - lane_count(mask_from_bits(retraced));
+    }
+
+    aabb bounding_box() const override { return world.bounding_box(); }
+
+    long long rays() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        long long total = 0;
+        for (const auto& s : slots)
+            total += s.second.rays;
+        return total;
+    }
+
+  private:
+    struct slot {
+        long long rays = 0;
+        char pad[64 - sizeof(long long)];  // Keeps neighbouring threads' slots on separate lines
+    };
+
+    slot& local_slot() const {
+        // The calling thread's slot, created on its first ray. Each thread caches the slot of
+        // the counter it used last, by id rather than address, so a new counter at the same
+        // address does not inherit a stale slot; on a miss it finds its slot in this counter's
+        // map, so switching between counters reuses slots instead of adding new ones.
+        struct cached_slot {
+            unsigned long long owner = 0;
+            slot* s = nullptr;
+        };
+        thread_local cached_slot cache;
+        if (cache.owner != id) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cache.owner = id;
+            cache.s = &slots[std::this_thread::get_id()];
+        }
+        return *cache.s;
+    }
+
+    static unsigned long long next_id() {
+        static std::atomic<unsigned long long> last{0};
+        return ++last;
+    }
+
+    const hittable& world;
+    const unsigned long long id;
+    mutable std::mutex mutex;
+    mutable std::map<std::thread::id, slot> slots;  // A map never moves its elements as it grows
+};
+
+#endif
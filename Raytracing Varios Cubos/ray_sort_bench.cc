@@ -0,0 +1,198 @@
+#include "rtweekend.h"
+#include "bvh4.h"
+#include "bvh_builder.h"
+#include "scenes.h"
+#include "wavefront.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Measures what sorting secondary rays (sort_rays_for_coherence) buys on the cube field.
+//
+// The first part collects the rays of bounces 1 .. 3 of a pinhole render and traces them in
+// pixel order and in sorted order, one at a time and in SIMD packets. It reports Mrays/s and the
+// primitive hit rate: how often a ray's closest hit is the primitive the previous ray hit, a
+// proxy for how much of the BVH and primitive data the previous ray left in cache (the hardware
+// counters are not available everywhere). The second part times whole wavefront renders with
+// and without the sort stage.
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct trace_result {
+    double seconds;
+    long long hits;
+    long long same_prim;  // Hits on the primitive the previous ray hit
+};
+
+static trace_result trace_rays(const hittable& world, const std::vector<ray>& rays, int repeats) {
+    // Traces the rays one at a time, in the order given; the best of `repeats` runs.
+    trace_result best = { infinity, 0, 0 };
+    for (int rep = 0; rep < repeats; rep++) {
+        trace_result result = { 0, 0, 0 };
+        const hittable* previous = nullptr;
+        auto start = std::chrono::steady_clock::now();
+        for (const ray& r : rays) {
+            hit_record rec;
+            if (world.hit(r, interval(0.000001, infinity), rec)) {
+                result.hits++;
+                result.same_prim += (rec.prim == previous);
+                previous = rec.prim;
+            } else {
+                previous = nullptr;
+            }
+        }
+        result.seconds = seconds_since(start);
+        if (result.seconds < best.seconds)
+            best = result;
+    }
+    return best;
+}
+
+static trace_result trace_packets(const hittable& world, const std::vector<ray>& rays, int repeats) {
+    // Traces the rays in packets of simd_width consecutive rays, finishing each lane's hit in
+    // double as camera::trace_primary_packet does.
+    trace_result best = { infinity, 0, 0 };
+    for (int rep = 0; rep < repeats; rep++) {
+        trace_result result = { 0, 0, 0 };
+        const hittable* previous = nullptr;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t first = 0; first < rays.size(); first += simd_width) {
+            int lanes = static_cast<int>(std::min<size_t>(simd_width, rays.size() - first));
+            ray_packet packet;
+            packet.t_min = 0.000001f;
+            for (int k = 0; k < simd_width; k++)
+                packet.set(k, rays[first + std::min(k, lanes - 1)]);
+
+            packet_hit hits;
+            world.hit_packet(packet, mask_from_bits((1 << lanes) - 1), hits);
+            for (int k = 0; k < lanes; k++) {
+                hit_record rec;
+                const ray& r = packet.lanes[k];
+                bool hit = hits.prim[k] && hits.prim[k]->hit(r, interval(0.000001, infinity), rec);
+                if (hits.prim[k] && !hit)
+                    hit = world.hit(r, interval(0.000001, infinity), rec);
+                if (hit) {
+                    result.hits++;
+                    result.same_prim += (rec.prim == previous);
+                    previous = rec.prim;
+                } else {
+                    previous = nullptr;
+                }
+            }
+        }
+        result.seconds = seconds_since(start);
+        if (result.seconds < best.seconds)
+            best = result;
+    }
+    return best;
+}
+
+static void report(const char* name, const trace_result& r, size_t count) {
+    std::printf("  %-14s %8.3f s  %7.2f Mrays/s  hit %5.1f%%  primitive hit rate %5.1f%%\n", name,
+                r.seconds, count / r.seconds / 1e6, 100.0 * r.hits / count,
+                r.hits ? 100.0 * r.same_prim / r.hits : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+    int width = 500, samples = 4, repeats = 3, render_samples = 8;
+    for (int k = 1; k < argc; k++) {
+        if (!std::strcmp(argv[k], "-w") && k + 1 < argc)      width = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-n") && k + 1 < argc) samples = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-r") && k + 1 < argc) repeats = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-s") && k + 1 < argc) render_samples = std::atoi(argv[++k]);
+        else {
+            std::fprintf(stderr, "Usage: %s [-w width] [-n rays per pixel] [-r repeats] [-s render spp]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    hittable_list world;
+    camera cam;
+    cube_field_scene(world, cam);
+    {
+        thread_pool pool(cam.num_threads);
+        auto root = bvh_builder(pool).build(world.objects, bvh_build_mode::binned_sah);
+        world = hittable_list(make_shared<bvh4>(*root, world.objects));
+    }
+
+    // Pinhole rays through the scene camera's view, as camera::initialize() sets it up.
+    int height = std::max(1, static_cast<int>(width / cam.aspect_ratio));
+    vec3 w = unit_vector(cam.lookfrom - cam.lookat);
+    vec3 u = unit_vector(cross(cam.vup, w));
+    vec3 v = cross(w, u);
+    double viewport_height = 2 * tan_degrees(cam.vfov / 2);
+    vec3 du = viewport_height * (static_cast<double>(width) / height) * u / width;
+    vec3 dv = viewport_height * -v / height;
+    point3 corner = cam.lookfrom - w - du * (width / 2.0) - dv * (height / 2.0);
+
+    std::vector<ray> rays;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            for (int s = 0; s < samples; s++) {
+                seed_pixel_sample(0, i, j, s);
+                ray r(cam.lookfrom, corner + (i + random_double()) * du + (j + random_double()) * dv - cam.lookfrom);
+                for (int bounce = 0; bounce < 3; bounce++) {
+                    hit_record rec;
+                    color attenuation;
+                    ray scattered;
+                    if (!world.hit(r, interval(0.000001, infinity), rec)
+                        || !rec.mat->scatter(r, rec, attenuation, scattered))
+                        break;
+                    rays.push_back(scattered);
+                    r = scattered;
+                }
+            }
+        }
+    }
+
+    std::printf("Secondary rays (bounces 1-3 of %dx%d, %d per pixel): %zu\n", width, height, samples, rays.size());
+
+    // Sorting moves the rays themselves, as a wavefront queue would, so the sorted pass reads
+    // them sequentially too.
+    auto sort_start = std::chrono::steady_clock::now();
+    std::vector<int> order(rays.size());
+    for (size_t k = 0; k < order.size(); k++)
+        order[k] = static_cast<int>(k);
+    sort_rays_for_coherence(rays, order);
+    std::vector<ray> sorted_rays;
+    sorted_rays.reserve(rays.size());
+    for (int k : order)
+        sorted_rays.push_back(rays[k]);
+    double sort_seconds = seconds_since(sort_start);
+
+    trace_result unsorted = trace_rays(world, rays, repeats);
+    trace_result sorted = trace_rays(world, sorted_rays, repeats);
+    trace_result unsorted_packets = trace_packets(world, rays, repeats);
+    trace_result sorted_packets = trace_packets(world, sorted_rays, repeats);
+
+    report("pixel order", unsorted, rays.size());
+    report("sorted", sorted, rays.size());
+    report("packets", unsorted_packets, rays.size());
+    report("sorted packets", sorted_packets, rays.size());
+    std::printf("  sort           %8.3f s  %7.2f Mrays/s\n", sort_seconds, rays.size() / sort_seconds / 1e6);
+    std::printf("  speedup from sorting: %.2fx single rays, %.2fx packets (%.2fx, %.2fx counting the sort)\n",
+                unsorted.seconds / sorted.seconds, unsorted_packets.seconds / sorted_packets.seconds,
+                unsorted.seconds / (sorted.seconds + sort_seconds),
+                unsorted_packets.seconds / (sorted_packets.seconds + sort_seconds));
+
+    // Whole wavefront renders, where the sort runs before every secondary intersect stage.
+    std::printf("Wavefront render (%dx%d, %d spp):\n", width, height, render_samples);
+    cam.image_width = width;
+    cam.samples_per_pixel = render_samples;
+    cam.wavefront = true;
+    for (int sorting = 0; sorting < 2; sorting++) {
+        cam.sort_secondary_rays = (sorting == 1);
+        double best = infinity;
+        for (int rep = 0; rep < repeats; rep++) {
+            framebuffer image;
+            auto start = std::chrono::steady_clock::now();
+            cam.render(world, image);
+            best = std::min(best, seconds_since(start));
+        }
+        std::printf("  %-14s %8.3f s\n", sorting ? "sorted" : "unsorted", best);
+    }
+}
@@ -3,129 +3,118 @@
 
 #include "hittable.h"
 #include "material.h"
+#include "stats.h"
 
 // ---------------------
-// 1) xy_rect
-// Plano Z = k, abarca [x0,x1] y [y0,y1]
+// aa_rect<Axis>
+// Plano eje[Axis] = k. Abarca [a0,a1] y [b0,b1] en los otros dos ejes, tomados en orden
+// x, y, z (xy_rect: a = x, b = y; xz_rect: a = x, b = z; yz_rect: a = y, b = z).
+// Los tres rectngulos comparten este cdigo; slo cambia el eje.
 // ---------------------
-class xy_rect : public hittable {
+template <int Axis>
+class aa_rect final : public hittable {
 public:
-    xy_rect() {}
+    static const int A = (Axis == 0) ? 1 : 0;  // Primer eje del plano
+    static const int B = (Axis == 2) ? 1 : 2;  // Segundo eje del plano
+
+    aa_rect() {}
 
-    // k: la coordenada Z donde est el rectngulo
-    // x0, x1: rango en X
-    // y0, y1: rango en Y
+    // a0, a1: rango en el eje A
+    // b0, b1: rango en el eje B
+    // k: la coordenada en el eje Axis donde est el rectngulo
     // mat: material
-    xy_rect(double x0, double x1, double y0, double y1, double k,
+    aa_rect(double a0, double a1, double b0, double b1, double k,
         shared_ptr<material> mat)
-        : x0(x0), x1(x1), y0(y0), y1(y1), k(k), mp(mat)
+        : mp(scene_materials().add(mat)), a0(a0), a1(a1), b0(b0), b1(b1), k(k)
     {
     }
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override
     {
-        // Resolver interseccin con plano Z = k
-        double t = (k - r.origin().z()) / r.direction().z();
-        if (t < ray_t.min || t > ray_t.max) return false;
-
-        double x = r.origin().x() + t * r.direction().x();
-        double y = r.origin().y() + t * r.direction().y();
-        if (x < x0 || x > x1 || y < y0 || y > y1) return false;
-
-        rec.t = t;
-        rec.p = r.at(t);
-
-        // Normal sale en +z o -z segn el sentido del rayo
-        vec3 outward_normal(0, 0, 1);
-        rec.set_face_normal(r, outward_normal);
-        rec.mat = mp;
-
-        return true;
+        return intersect_and_finalize(r, ray_t, rec);
     }
 
-public:
-    shared_ptr<material> mp;
-    double x0, x1, y0, y1, k;
-};
-
-// ---------------------
-// 2) xz_rect
-// Plano Y = k, abarca [x0,x1] y [z0,z1]
-// ---------------------
-class xz_rect : public hittable {
-public:
-    xz_rect() {}
-
-    xz_rect(double x0, double x1, double z0, double z1, double k,
-        shared_ptr<material> mat)
-        : x0(x0), x1(x1), z0(z0), z1(z1), k(k), mp(mat)
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override
     {
-    }
+        RT_STAT(primitive_tests);
 
-    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override
-    {
-        // Interseccin con plano Y = k
-        double t = (k - r.origin().y()) / r.direction().y();
+        // Resolver interseccin con plano eje[Axis] = k
+        double t = (k - r.origin()[Axis]) / r.direction()[Axis];
         if (t < ray_t.min || t > ray_t.max) return false;
 
-        double x = r.origin().x() + t * r.direction().x();
-        double z = r.origin().z() + t * r.direction().z();
-        if (x < x0 || x > x1 || z < z0 || z > z1) return false;
+        double a = r.origin()[A] + t * r.direction()[A];
+        double b = r.origin()[B] + t * r.direction()[B];
+        if (a < a0 || a > a1 || b < b0 || b > b1) return false;
 
         rec.t = t;
-        rec.p = r.at(t);
-
-        // Normal sale en +y o -y
-        vec3 outward_normal(0, 1, 0);
-        rec.set_face_normal(r, outward_normal);
-        rec.mat = mp;
-
+        rec.prim = this;
         return true;
     }
 
-public:
-    shared_ptr<material> mp;
-    double x0, x1, z0, z1, k;
-};
-
-// ---------------------
-// 3) yz_rect
-// Plano X = k, abarca [y0,y1] y [z0,z1]
-// ---------------------
-class yz_rect : public hittable {
-public:
-    yz_rect() {}
-
-    yz_rect(double y0, double y1, double z0, double z1, double k,
-        shared_ptr<material> mat)
-        : y0(y0), y1(y1), z0(z0), z1(z1), k(k), mp(mat)
+    virtual void finalize(const ray& r, hit_record& rec) const override
     {
-    }
-
-    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override
-    {
-        // Interseccin con plano X = k
-        double t = (k - r.origin().x()) / r.direction().x();
-        if (t < ray_t.min || t > ray_t.max) return false;
-
-        double y = r.origin().y() + t * r.direction().y();
-        double z = r.origin().z() + t * r.direction().z();
-        if (y < y0 || y > y1 || z < z0 || z > z1) return false;
+        rec.p = r.at(rec.t);
 
-        rec.t = t;
-        rec.p = r.at(t);
-
-        // Normal sale en +x o -x
-        vec3 outward_normal(1, 0, 0);
+        // Normal sale en +eje o -eje segn el sentido del rayo
+        vec3 outward_normal(0, 0, 0);
+        outward_normal[Axis] = 1;
         rec.set_face_normal(r, outward_normal);
         rec.mat = mp;
+    }
 
-        return true;
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override
+    {
+        // La misma prueba que hit(), para todos los rayos del paquete a la vez
+        RT_STAT_ADD(primitive_tests, lane_count(active));
+        float plane = static_cast<float>(k);
+        vfloat inv = rays.inv_direction(Axis);
+        vfloat t = (vfloat(plane) - rays.origin(Axis)) * inv;
+        vfloat a = rays.origin(A) + t * rays.direction(A);
+        vfloat b = rays.origin(B) + t * rays.direction(B);
+
+        // Error de t en float, y cunto desplaza el punto de corte dentro del plano
+        vfloat t_err = rays.plane_t_error(Axis, plane);
+        vfloat a_err = t_err * vabs(rays.direction(A));
+        vfloat b_err = t_err * vabs(rays.direction(B));
+
+        vmask in_range = active & (t >= vfloat(rays.t_min)) & (t - t_err <= hits.t_limit());
+
+        // Los bordes se amplan con ese error: un rayo que roza el borde, o cuya t es poco
+        // precisa (casi paralelo al plano), queda marcado como dudoso
+        vmask near_edge = (a >= vfloat(static_cast<float>(a0) - packet_pad(a0)) - a_err)
+                        & (a <= vfloat(static_cast<float>(a1) + packet_pad(a1)) + a_err)
+                        & (b >= vfloat(static_cast<float>(b0) - packet_pad(b0)) - b_err)
+                        & (b <= vfloat(static_cast<float>(b1) + packet_pad(b1)) + b_err);
+        vmask hit = in_range & near_edge;
+        if (!any(hit))
+            return;
+        vmask inside = (a >= vfloat(static_cast<float>(a0))) & (a <= vfloat(static_cast<float>(a1)))
+                     & (b >= vfloat(static_cast<float>(b0))) & (b <= vfloat(static_cast<float>(b1)));
+        hits.mark_uncertain(andnot(hit, inside) | (hit & (t_err > vfloat(0.5f) * packet_slack(t))));
+        hits.record(hit, t, this);
+    }
+
+    virtual aabb bounding_box() const override {
+        // The rectangle has no thickness along its normal, so pad that axis a little.
+        interval axes[3];
+        axes[A] = interval(a0, a1);
+        axes[B] = interval(b0, b1);
+        axes[Axis] = interval(k, k).expand(0.0001);
+        return aabb(axes[0], axes[1], axes[2]);
     }
 
 public:
-    shared_ptr<material> mp;
-    double y0, y1, z0, z1, k;
+    const material* mp;
+    double a0, a1, b0, b1, k;
 };
 
+// Plano Z = k, abarca [x0,x1] y [y0,y1]
+using xy_rect = aa_rect<2>;
+
+// Plano Y = k, abarca [x0,x1] y [z0,z1]
+using xz_rect = aa_rect<1>;
+
+// Plano X = k, abarca [y0,y1] y [z0,z1]
+using yz_rect = aa_rect<0>;
+
 #endif
@@ -0,0 +1,253 @@
+#include "rtweekend.h"
+#include "bvh4.h"
+#include "build_info.h"
+#include "bvh_builder.h"
+#include "image_writer.h"
+#include "ray_counter.h"
+#include "scenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Golden-image regression and performance tracking.
+//
+// Renders each canonical scene small and compares it with its golden image
+// (<golden dir>/<scene>.ppm) by PSNR and SSIM, then times the render and compares its Mrays/s
+// with this machine's earlier runs of the same build configuration (build_config()) in the
+// history file, to which it appends a row. Exits with status 1 if any scene looks different or
+// got slower beyond the thresholds. Renders are bit-identical across thread counts and machines
+// (see the RT_DETERMINISTIC CMake option), so an unchanged renderer scores an infinite PSNR; the
+// tolerances leave room for changes that only move rounding.
+//
+// After a change that is meant to alter the picture, rerun with -u to write new golden images.
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct scene_entry {
+    const char* name;
+    void (*build)(hittable_list&, camera&);
+};
+
+static bool read_ppm(const std::string& path, int& width, int& height, std::vector<uint8_t>& bytes) {
+    // Reads a binary P6 with 8-bit channels, as write_ppm() writes it.
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int max_value = 0;
+    if (!(in >> magic >> width >> height >> max_value) || magic != "P6" || max_value != 255)
+        return false;
+    in.get();  // The single whitespace character after the header
+    bytes.resize(static_cast<size_t>(width) * height * 3);
+    in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(in);
+}
+
+static double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    // Peak signal-to-noise ratio of two 8-bit images, in dB (infinite when they are equal).
+    double sum = 0;
+    for (size_t k = 0; k < a.size(); k++) {
+        double d = static_cast<double>(a[k]) - b[k];
+        sum += d * d;
+    }
+    if (sum == 0)
+        return infinity;
+    return 10 * std::log10(255.0 * 255.0 / (sum / a.size()));
+}
+
+static double ssim(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height) {
+    // Mean structural similarity of the two images' luma over 8x8 windows placed every 4
+    // pixels, with the usual constants (K1 = 0.01, K2 = 0.03, 8-bit range).
+    auto luma = [&](const std::vector<uint8_t>& img, int i, int j) {
+        const uint8_t* p = &img[(static_cast<size_t>(j) * width + i) * 3];
+        return 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+    };
+    const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+    const int window = 8, step = 4;
+
+    double total = 0;
+    int windows = 0;
+    for (int y0 = 0; y0 + window <= height; y0 += step) {
+        for (int x0 = 0; x0 + window <= width; x0 += step) {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (int j = y0; j < y0 + window; j++) {
+                for (int i = x0; i < x0 + window; i++) {
+                    double va = luma(a, i, j), vb = luma(b, i, j);
+                    sa += va; sb += vb;
+                    saa += va * va; sbb += vb * vb; sab += va * vb;
+                }
+            }
+            double n = window * window;
+            double ma = sa / n, mb = sb / n;
+            double var_a = saa / n - ma * ma, var_b = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            total += (2 * ma * mb + c1) * (2 * cov + c2) / ((ma * ma + mb * mb + c1) * (var_a + var_b + c2));
+            windows++;
+        }
+    }
+    return windows ? total / windows : 1.0;
+}
+
+static double baseline_mrays(const std::string& history_path, const std::string& host, const std::string& scene,
+                             const std::string& config, int width, int spp, int runs) {
+    // The median Mrays/s of the last `runs` rows for this host, build configuration, scene and
+    // setting, or 0 when there are none. The median of several runs keeps one noisy entry from
+    // setting the bar.
+    std::ifstream in(history_path);
+    std::string line;
+    std::vector<double> rates;
+    std::getline(in, line);  // Header
+    while (std::getline(in, line)) {
+        // timestamp,host,label,scene,width,height,spp,seconds,mrays_per_second,psnr,ssim,config
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        std::string field;
+        while (std::getline(row, field, ','))
+            fields.push_back(field);
+        if (fields.size() < 12 || fields[1] != host || fields[11] != config || fields[3] != scene
+            || std::atoi(fields[4].c_str()) != width || std::atoi(fields[6].c_str()) != spp)
+            continue;
+        rates.push_back(std::atof(fields[8].c_str()));
+    }
+    if (rates.empty())
+        return 0;
+    if (static_cast<int>(rates.size()) > runs)
+        rates.erase(rates.begin(), rates.end() - runs);
+    std::sort(rates.begin(), rates.end());
+    return rates[rates.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+    int width = 160, samples = 32, repeats = 5, baseline_runs = 5;
+    double min_psnr = 40, min_ssim = 0.99, max_slowdown = 0.15;
+    std::string golden_dir = "golden", history_path = "regression_history.csv", label;
+    const std::string config = build_config();
+    bool update = false;
+    for (int k = 1; k < argc; k++) {
+        if (!std::strcmp(argv[k], "-w") && k + 1 < argc)      width = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-n") && k + 1 < argc) samples = std::atoi(argv[++k]);
+        else if (!std::strcmp(argv[k], "-r") && k + 1 < argc) repeats = std::max(1, std::atoi(argv[++k]));
+        else if (!std::strcmp(argv[k], "-g") && k + 1 < argc) golden_dir = argv[++k];
+        else if (!std::strcmp(argv[k], "-H") && k + 1 < argc) history_path = argv[++k];
+        else if (!std::strcmp(argv[k], "-l") && k + 1 < argc) label = argv[++k];
+        else if (!std::strcmp(argv[k], "-p") && k + 1 < argc) min_psnr = std::atof(argv[++k]);
+        else if (!std::strcmp(argv[k], "-s") && k + 1 < argc) min_ssim = std::atof(argv[++k]);
+        else if (!std::strcmp(argv[k], "-x") && k + 1 < argc) max_slowdown = std::atof(argv[++k]);
+        else if (!std::strcmp(argv[k], "-u")) update = true;
+        else {
+            std::fprintf(stderr, "Usage: %s [-w width] [-n spp] [-r timing repeats] [-g golden dir] [-H history file]\n"
+                                 "       [-l label] [-p min PSNR dB] [-s min SSIM] [-x max slowdown] [-u]\n"
+                                 "  -u  Write the renders as the new golden images instead of comparing\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ofstream history;
+    if (!update) {
+        bool new_history = !std::ifstream(history_path).good();
+        history.open(history_path, std::ios::app);
+        if (!history) {
+            std::fprintf(stderr, "Cannot open '%s' for writing\n", history_path.c_str());
+            return 1;
+        }
+        if (new_history)
+            history << "timestamp,host,label,scene,width,height,spp,seconds,mrays_per_second,psnr,ssim,config\n" << std::flush;
+    }
+
+    const scene_entry scenes[] = {
+        { "cube_field", cube_field_scene },
+        { "single_cube", single_cube_scene },
+        { "spheres_and_cubes", spheres_and_cubes_scene },
+    };
+
+    bool failed = false;
+    std::streambuf* log = std::clog.rdbuf(nullptr);  // Silence the renderer's progress output
+    for (const auto& scene : scenes) {
+        // Each scene starts from the same random stream, so its objects do not depend on
+        // which scenes were built before it. The previous scene's world is gone, so its
+        // materials can go too.
+        thread_rng() = pcg32();
+        scene_materials().clear();
+        hittable_list world;
+        camera cam;
+        scene.build(world, cam);
+        {
+            thread_pool pool(cam.num_threads);
+            auto root = bvh_builder(pool).build(world.objects, bvh_build_mode::binned_sah);
+            world = hittable_list(make_shared<bvh4>(*root, world.objects));
+        }
+        cam.image_width = width;
+        cam.samples_per_pixel = samples;
+
+        // Best of `repeats` renders; the rays of one render give the rate.
+        framebuffer image;
+        double seconds = infinity;
+        long long rays = 0;
+        for (int rep = 0; rep < repeats; rep++) {
+            ray_counter counter(world);
+            auto start = std::chrono::steady_clock::now();
+            cam.render(counter, image);
+            seconds = std::min(seconds, seconds_since(start));
+            rays = counter.rays();
+        }
+        double mrays = rays / seconds / 1e6;
+
+        std::string golden_path = golden_dir + "/" + scene.name + ".ppm";
+        if (update) {
+            std::ofstream out(golden_path, std::ios::binary);
+            if (!out) {
+                std::fprintf(stderr, "Cannot write '%s'\n", golden_path.c_str());
+                return 1;
+            }
+            write_ppm(out, image);
+            std::printf("%-18s wrote %s\n", scene.name, golden_path.c_str());
+            continue;
+        }
+
+        std::vector<uint8_t> rendered, golden;
+        image.quantize(rendered);
+        int golden_width = 0, golden_height = 0;
+        double image_psnr = 0, image_ssim = 0;
+        bool image_ok = read_ppm(golden_path, golden_width, golden_height, golden)
+                     && golden_width == image.width && golden_height == image.height;
+        if (image_ok) {
+            image_psnr = psnr(rendered, golden);
+            image_ssim = ssim(rendered, golden, image.width, image.height);
+            image_ok = image_psnr >= min_psnr && image_ssim >= min_ssim;
+        }
+
+        double baseline = baseline_mrays(history_path, host, scene.name, config, width, samples, baseline_runs);
+        bool speed_ok = baseline <= 0 || mrays >= (1 - max_slowdown) * baseline;
+
+        std::printf("%-18s PSNR %6.1f dB  SSIM %.4f  %s   %6.3f s  %6.2f Mrays/s", scene.name, image_psnr,
+                    image_ssim, image_ok ? "ok" : (golden.empty() ? "NO GOLDEN" : "CHANGED"), seconds, mrays);
+        if (baseline > 0)
+            std::printf(" (baseline %.2f, %+.1f%%)  %s", baseline, 100 * (mrays / baseline - 1),
+                        speed_ok ? "ok" : "SLOWER");
+        std::printf("\n");
+        failed = failed || !image_ok || !speed_ok;
+
+        history << timestamp << ',' << host << ',' << label << ',' << scene.name << ',' << image.width << ','
+                << image.height << ',' << samples << ',' << seconds << ',' << mrays << ','
+                << image_psnr << ',' << image_ssim << ',' << config << '\n';
+    }
+    std::clog.rdbuf(log);
+
+    if (!update)
+        std::printf("%s (history: %s, build %s)\n", failed ? "FAILED" : "PASSED", history_path.c_str(), config.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+#include "rtweekend.h"
+#include "bvh4.h"
+#include "bvh_builder.h"
+#include "color.h"
+#include "ray_counter.h"
+#include "scenes.h"
+#include "sphere.h"
+#include <benchmark/benchmark.h>
+#include <sstream>
+#include <vector>
+
+// Microbenchmarks of the tracer's hot paths, and whole renders of the cube field.
+//
+// Every intersection benchmark cycles through the same fixed set of rays, aimed at the unit
+// cube around the origin so that some hit the object under test and some miss it; the rates
+// are rays per second.
+
+static const std::vector<ray>& test_rays() {
+    static std::vector<ray> rays;
+    if (rays.empty()) {
+        pcg32 rng;
+        rng.seed(2024);
+        for (int k = 0; k < 1024; k++) {
+            point3 origin = 4 * unit_vector(vec3(rng.next_double() - 0.5, rng.next_double() - 0.5,
+                                                 rng.next_double() - 0.5));
+            point3 target(2.4 * rng.next_double() - 1.2, 2.4 * rng.next_double() - 1.2,
+                          2.4 * rng.next_double() - 1.2);
+            rays.push_back(ray(origin, target - origin));
+        }
+    }
+    return rays;
+}
+
+static void run_hit(benchmark::State& state, const hittable& object) {
+    // Traces the test rays against `object` through its hit().
+    const auto& rays = test_rays();
+    size_t k = 0;
+    long long hits = 0;
+    for (auto _ : state) {
+        hit_record rec;
+        hits += object.hit(rays[k], interval(0.001, infinity), rec);
+        benchmark::DoNotOptimize(rec);
+        k = (k + 1) % rays.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_fraction"] = static_cast<double>(hits) / state.iterations();
+}
+
+static shared_ptr<material> bench_material() {
+    static auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    return mat;
+}
+
+static void BM_sphere_hit(benchmark::State& state) {
+    sphere s(point3(0, 0, 0), 1, bench_material());
+    run_hit(state, s);
+}
+BENCHMARK(BM_sphere_hit);
+
+static void BM_xy_rect_hit(benchmark::State& state) {
+    xy_rect rect(-1, 1, -1, 1, 0, bench_material());
+    run_hit(state, rect);
+}
+BENCHMARK(BM_xy_rect_hit);
+
+static void BM_xz_rect_hit(benchmark::State& state) {
+    xz_rect rect(-1, 1, -1, 1, 0, bench_material());
+    run_hit(state, rect);
+}
+BENCHMARK(BM_xz_rect_hit);
+
+static void BM_yz_rect_hit(benchmark::State& state) {
+    yz_rect rect(-1, 1, -1, 1, 0, bench_material());
+    run_hit(state, rect);
+}
+BENCHMARK(BM_yz_rect_hit);
+
+static void BM_cube_hit_rects(benchmark::State& state) {
+    // cube: six aa_rects in a hittable_list.
+    cube c(point3(-1, -1, -1), point3(1, 1, 1), bench_material());
+    run_hit(state, c);
+}
+BENCHMARK(BM_cube_hit_rects);
+
+static void BM_cube_hit_slabs(benchmark::State& state) {
+    // box: the same cube as a single slab test.
+    box b(point3(-1, -1, -1), point3(1, 1, 1), bench_material());
+    run_hit(state, b);
+}
+BENCHMARK(BM_cube_hit_slabs);
+
+static void BM_hittable_list_hit(benchmark::State& state) {
+    // A flat list of small spheres scattered through the target cube, tested one by one.
+    pcg32 rng;
+    rng.seed(7);
+    hittable_list list;
+    for (int64_t k = 0; k < state.range(0); k++) {
+        point3 center(2 * rng.next_double() - 1, 2 * rng.next_double() - 1, 2 * rng.next_double() - 1);
+        list.add(make_shared<sphere>(center, 0.1, bench_material()));
+    }
+    run_hit(state, list);
+}
+BENCHMARK(BM_hittable_list_hit)->RangeMultiplier(4)->Range(1, 1024);
+
+template <typename M>
+static void run_scatter(benchmark::State& state, const M& mat) {
+    // Scatters the test rays off the unit sphere at their hit points.
+    sphere s(point3(0, 0, 0), 1, bench_material());
+    std::vector<std::pair<ray, hit_record>> hits;
+    for (const auto& r : test_rays()) {
+        hit_record rec;
+        if (s.hit(r, interval(0.001, infinity), rec))
+            hits.push_back(std::make_pair(r, rec));
+    }
+
+    thread_rng().seed(1);
+    size_t k = 0;
+    for (auto _ : state) {
+        color attenuation;
+        ray scattered;
+        bool scattered_ok = mat.M::scatter(hits[k].first, hits[k].second, attenuation, scattered);
+        benchmark::DoNotOptimize(scattered_ok);
+        benchmark::DoNotOptimize(scattered);
+        k = (k + 1) % hits.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_lambertian_scatter(benchmark::State& state) {
+    run_scatter(state, lambertian(color(0.7, 0.3, 0.2)));
+}
+BENCHMARK(BM_lambertian_scatter);
+
+static void BM_metal_scatter(benchmark::State& state) {
+    run_scatter(state, metal(color(0.7, 0.6, 0.5), 0.3));
+}
+BENCHMARK(BM_metal_scatter);
+
+static void BM_dielectric_scatter(benchmark::State& state) {
+    run_scatter(state, dielectric(1.5));
+}
+BENCHMARK(BM_dielectric_scatter);
+
+static void BM_write_color(benchmark::State& state) {
+    // One image row of 512 pixels per iteration, into a reused string stream.
+    std::vector<color> row;
+    for (int i = 0; i < 512; i++)
+        row.push_back(color(i / 512.0, 0.5, 1 - i / 512.0));
+    std::ostringstream out;
+    for (auto _ : state) {
+        out.str(std::string());
+        for (const auto& c : row)
+            write_color(out, c);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(row.size()));
+}
+BENCHMARK(BM_write_color);
+
+static void BM_render_cube_field(benchmark::State& state) {
+    // The main.cc scene at its full 500 pixel width and range(0) samples per pixel, traced
+    // depth first (range(1) == 0) or in wavefront mode (range(1) == 1).
+    static hittable_list world;
+    static camera scene_camera;
+    if (world.objects.empty()) {
+        hittable_list objects;
+        cube_field_scene(objects, scene_camera);
+        thread_pool pool(scene_camera.num_threads);
+        auto root = bvh_builder(pool).build(objects.objects, bvh_build_mode::binned_sah);
+        world = hittable_list(make_shared<bvh4>(*root, objects.objects));
+    }
+
+    camera cam = scene_camera;
+    cam.samples_per_pixel = static_cast<int>(state.range(0));
+    cam.wavefront = state.range(1) != 0;
+    ray_counter counter(world);
+
+    std::streambuf* log = std::clog.rdbuf(nullptr);  // Silence the progress output
+    for (auto _ : state) {
+        framebuffer image;
+        cam.render(counter, image);
+        benchmark::DoNotOptimize(image);
+    }
+    std::clog.rdbuf(log);
+
+    double rays = static_cast<double>(counter.rays());
+    state.counters["Mrays/s"] = benchmark::Counter(rays / 1e6, benchmark::Counter::kIsRate);
+    state.counters["rays/sample"] = rays
+        / (static_cast<double>(state.iterations()) * cam.samples_per_pixel * cam.image_width
+           * static_cast<int>(cam.image_width / cam.aspect_ratio));
+}
+BENCHMARK(BM_render_cube_field)
+    ->ArgNames({"spp", "wavefront"})
+    ->Args({1, 0})->Args({8, 0})->Args({8, 1})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,6 +1,8 @@
 #ifndef RTWEEKEND_H
 #define RTWEEKEND_H
 
+#include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <cstdlib>
@@ -10,11 +12,93 @@
 using std::shared_ptr;
 using std::make_shared;
 
+// Random Numbers
+
+class pcg32 {
+    // PCG32 generator (O'Neill, pcg-random.org): a 64-bit LCG whose output is permuted by an
+    // xorshift and a random rotation. Two words of state, no locks, and good statistics.
+  public:
+    pcg32() { seed(0x853c49e6748fea9bULL); }
+    explicit pcg32(uint64_t initstate, uint64_t initseq = 0xda3e39cb94b95bdbULL) {
+        seed(initstate, initseq);
+    }
+
+    void seed(uint64_t initstate, uint64_t initseq = 0xda3e39cb94b95bdbULL) {
+        state = 0;
+        inc = (initseq << 1) | 1;
+        next_uint();
+        state += initstate;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    double next_double() {
+        // Returns a random real in [0,1) with 32 bits of resolution.
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+  public:
+    uint64_t state, inc;
+};
+
+inline uint64_t mix_bits(uint64_t v) {
+    // SplitMix64 finalizer: turns structured keys (pixel and sample indices) into well spread
+    // seeds, so neighbouring pixels do not get correlated streams.
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= v >> 33;
+    return v;
+}
+
+inline pcg32& thread_rng() {
+    // Every thread draws from its own generator, so parallel renders never contend on shared
+    // RNG state. The camera reseeds it for each pixel sample.
+    static thread_local pcg32 rng;
+    return rng;
+}
+
+inline void seed_pixel_sample(uint64_t seed, int i, int j, int sample) {
+    // Makes the random stream of sample `sample` of pixel (i,j) a pure function of its indices.
+    uint64_t pixel = (static_cast<uint64_t>(static_cast<uint32_t>(j)) << 32) | static_cast<uint32_t>(i);
+    thread_rng().seed(mix_bits(mix_bits(seed ^ pixel) + static_cast<uint64_t>(sample)));
+}
+
+class sampler {
+    // Source of a pixel sample's random numbers, indexed by dimension (see sampler.h). While a
+    // thread has one installed, random_double() draws from it instead of from thread_rng().
+  public:
+    virtual ~sampler() = default;
+
+    // Starts sample `index` of the `count` taken for pixel (i,j), at dimension 0.
+    virtual void start_sample(int i, int j, int index, int count) = 0;
+
+    // Makes the next draw come from dimension `dim`; later draws continue from there.
+    virtual void set_dimension(int dim) = 0;
+
+    virtual double next_1d() = 0;
+};
+
+inline sampler*& thread_sampler() {
+    static thread_local sampler* installed = nullptr;
+    return installed;
+}
+
 // Utility Functions
 
 double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    if (sampler* s = thread_sampler())
+        return s->next_1d();
+    return thread_rng().next_double();
 }
 
 double random_double(double min, double max) {
@@ -33,6 +117,35 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+inline void sin_cos_turns(double turns, double& s, double& c) {
+    // Sine and cosine of the angle 2*pi*turns. Made of additions and multiplications only, so
+    // every IEEE machine computes the same bits (libm's sin and cos may differ in the last bit
+    // between C libraries). The angle is reduced to the nearest quarter turn, leaving at most
+    // pi/4, where the Taylor series below are accurate to about one ulp.
+    double quarter = std::floor(turns * 4 + 0.5);
+    double a = 2 * pi * (turns - 0.25 * quarter);
+    double a2 = a * a;
+    double sa = a * (1 + a2 * (-1.0/6 + a2 * (1.0/120 + a2 * (-1.0/5040 + a2 * (1.0/362880
+              + a2 * (-1.0/39916800 + a2 * (1.0/6227020800 + a2 * (-1.0/1307674368000
+              + a2 * (1.0/355687428096000)))))))));
+    double ca = 1 + a2 * (-0.5 + a2 * (1.0/24 + a2 * (-1.0/720 + a2 * (1.0/40320
+              + a2 * (-1.0/3628800 + a2 * (1.0/479001600 + a2 * (-1.0/87178291200
+              + a2 * (1.0/20922789888000))))))));
+    switch (static_cast<int>(quarter - 4 * std::floor(quarter / 4))) {
+        case 0:  s =  sa; c =  ca; break;
+        case 1:  s =  ca; c = -sa; break;
+        case 2:  s = -sa; c = -ca; break;
+        default: s = -ca; c =  sa; break;
+    }
+}
+
+inline double tan_degrees(double degrees) {
+    // tan() of an angle in degrees, as reproducible as sin_cos_turns().
+    double s, c;
+    sin_cos_turns(degrees / 360, s, c);
+    return s / c;
+}
+
 
 // Headers 
 
@@ -0,0 +1,392 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Pixel samplers. The camera installs one per render thread (sampler_scope) and pins the
+// dimension each decision draws from, so the same decision in every sample of a pixel comes from
+// the same well-distributed sequence:
+//
+//   dimensions 0-1  pixel offset (camera::jitter)
+//   dimensions 2-3  lens position (defocus)
+//   dimensions 4+4b the scatter of bounce b (random_unit_vector in material.h and the like),
+//                   with 4b+7 its Russian roulette decision
+//
+// Dimensions past the last bounce the sampler covers are padded with the pixel's pcg32 stream.
+// Low-discrepancy points reach a given noise level with far fewer samples than independent ones.
+
+const int sample_dim_pixel = 0;
+const int sample_dim_lens = 2;
+const int sample_dim_bounce = 4;
+const int sample_dims_per_bounce = 4;
+
+enum class sampler_type { independent, stratified, halton, sobol, blue_noise };
+
+inline bool parse_sampler_type(const std::string& name, sampler_type& type) {
+    if (name == "independent") { type = sampler_type::independent; return true; }
+    if (name == "stratified")  { type = sampler_type::stratified;  return true; }
+    if (name == "halton")      { type = sampler_type::halton;      return true; }
+    if (name == "sobol")       { type = sampler_type::sobol;       return true; }
+    if (name == "bluenoise")   { type = sampler_type::blue_noise;  return true; }
+    return false;
+}
+
+inline const char* sampler_type_name(sampler_type type) {
+    // The name parse_sampler_type() accepts for `type`.
+    switch (type) {
+        case sampler_type::independent: return "independent";
+        case sampler_type::stratified:  return "stratified";
+        case sampler_type::halton:      return "halton";
+        case sampler_type::sobol:       return "sobol";
+        case sampler_type::blue_noise:  return "bluenoise";
+    }
+    return "unknown";
+}
+
+inline void select_sample_dimension(int dim) {
+    // Points the installed sampler, if any, at dimension `dim`.
+    if (sampler* s = thread_sampler())
+        s->set_dimension(dim);
+}
+
+inline void start_pixel_sample(int i, int j, int index, int count) {
+    if (sampler* s = thread_sampler())
+        s->start_sample(i, j, index, count);
+}
+
+inline uint32_t reverse_bits(uint32_t v) {
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+    v = ((v >> 8) & 0x00FF00FFu) | ((v & 0x00FF00FFu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+inline uint32_t permutation_element(uint32_t i, uint32_t n, uint32_t p) {
+    // Element i of a pseudo-random permutation of 0 .. n-1 selected by p (Kensler, "Correlated
+    // Multi-Jittered Sampling"), without storing the permutation.
+    uint32_t w = n - 1;
+    w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+    do {
+        i ^= p;          i *= 0xe170893d;
+        i ^= p >> 16;    i ^= (i & w) >> 4;
+        i ^= p >> 8;     i *= 0x0929eb3f;
+        i ^= p >> 23;    i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69; i ^= (i & w) >> 11;
+        i *= 0x74dcb303; i ^= (i & w) >> 2;
+        i *= 0x9e501cc3; i ^= (i & w) >> 2;
+        i *= 0xc860a3df; i &= w;
+        i ^= i >> 5;
+    } while (i >= n);
+    return (i + p) % n;
+}
+
+inline uint32_t owen_scramble(uint32_t v, uint32_t seed) {
+    // Nested uniform (Owen) scrambling of a 32-bit fixed-point value, via the Laine-Karras
+    // hash: each bit is flipped depending only on the bits above it, which keeps the
+    // stratification of a (0,2)-sequence while decorrelating pixels.
+    v = reverse_bits(v);
+    v += seed;
+    v ^= v * 0x6c50b47cu;
+    v ^= v * 0xb82f1e52u;
+    v ^= v * 0xc7afe638u;
+    v ^= v * 0x8d22f6e6u;
+    return reverse_bits(v);
+}
+
+// Shared bookkeeping: tracks the pixel, sample and dimension, and hands dimensions below
+// max_dimensions to the concrete sequence. The others come from thread_rng().
+class dimension_sampler : public sampler {
+  public:
+    static const int max_dimensions = sample_dim_bounce + 16 * sample_dims_per_bounce;
+
+    explicit dimension_sampler(uint64_t seed) : seed(seed) {}
+
+    void start_sample(int i, int j, int index, int count) override {
+        px = i;
+        py = j;
+        sample_index = index;
+        sample_count = std::max(count, 1);
+        dim = 0;
+        pixel_key = mix_bits(seed ^ ((static_cast<uint64_t>(static_cast<uint32_t>(j)) << 32)
+                                     | static_cast<uint32_t>(i)));
+    }
+
+    void set_dimension(int d) override { dim = d; }
+
+    double next_1d() override {
+        int d = dim++;
+        if (d >= max_dimensions)
+            return thread_rng().next_double();
+        // By value, not std::min: a reference would need an out-of-class definition in C++11.
+        double u = sample(d);
+        return u < one_minus_epsilon ? u : one_minus_epsilon;
+    }
+
+  protected:
+    uint64_t seed;
+    uint64_t pixel_key = 0;
+    int px = 0, py = 0;
+    int sample_index = 0, sample_count = 1;
+    int dim = 0;
+
+    static constexpr double one_minus_epsilon = 1.0 - 1.0 / 9007199254740992.0;
+
+    virtual double sample(int d) const = 0;
+
+    uint32_t pixel_hash(int d) const {
+        // Hash of the pixel and a dimension, for per-pixel scrambles and permutations.
+        return static_cast<uint32_t>(mix_bits(pixel_key + 0x9e3779b97f4a7c15ULL * (d + 1)));
+    }
+
+    uint32_t dimension_hash(int d) const {
+        // Hash of the dimension alone, shared by every pixel of the image.
+        return static_cast<uint32_t>(mix_bits(seed + 0x9e3779b97f4a7c15ULL * (d + 1)));
+    }
+
+    double sample_hash_uniform(int d) const {
+        // Uniform value that depends on pixel, dimension and sample index.
+        uint64_t h = mix_bits(pixel_key ^ (static_cast<uint64_t>(sample_index) << 8 | d) * 0xbf58476d1ce4e5b9ULL);
+        return (h >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// Stratified: the samples of a pixel are spread over a jittered grid. Dimension pairs (pixel
+// offset, lens, the two angles of a bounce) share a 2D grid when the sample count is a square;
+// otherwise, and for each dimension on its own, the marginals are stratified into
+// sample_count slices (Latin hypercube). Pixels and dimensions use independent permutations.
+class stratified_sampler : public dimension_sampler {
+  public:
+    using dimension_sampler::dimension_sampler;
+
+  protected:
+    double sample(int d) const override {
+        int n = sample_count;
+        int m = static_cast<int>(std::sqrt(static_cast<double>(n)) + 0.5);
+        if (m * m == n) {
+            int pair = d / 2;
+            uint32_t cell = permutation_element(sample_index % n, n, pixel_hash(pair));
+            int stratum = (d % 2 == 0) ? static_cast<int>(cell % m) : static_cast<int>(cell / m);
+            return (stratum + sample_hash_uniform(d)) / m;
+        }
+        uint32_t stratum = permutation_element(sample_index % n, n, pixel_hash(d));
+        return (stratum + sample_hash_uniform(d)) / n;
+    }
+};
+
+// Halton: dimension d is the radical inverse of the sample index in the d-th prime base, with
+// every digit passed through a random permutation chosen per pixel, dimension and digit position
+// (random digit scrambling). Unscrambled, the large bases of the bounce dimensions line up in
+// visible patterns at low sample counts.
+class halton_sampler : public dimension_sampler {
+  public:
+    using dimension_sampler::dimension_sampler;
+
+  protected:
+    double sample(int d) const override {
+        static const int primes[max_dimensions] = {
+              2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,
+             59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107, 109, 113, 127, 131,
+            137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+            227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311,
+            313, 317, 331, 337
+        };
+        return scrambled_radical_inverse(primes[d], static_cast<uint64_t>(sample_index), pixel_hash(d));
+    }
+
+    static double scrambled_radical_inverse(int base, uint64_t a, uint32_t hash) {
+        // Digits are produced until their weight drops below double precision, so the
+        // trailing (zero) digits get scrambled too and the result is uniform in [0,1).
+        double inv_base = 1.0 / base, weight = inv_base, v = 0;
+        for (uint32_t position = 0; weight > 1e-16; position++) {
+            uint32_t digit = static_cast<uint32_t>(a % base);
+            a /= base;
+            uint32_t p = static_cast<uint32_t>(mix_bits(hash ^ (static_cast<uint64_t>(position) << 32)));
+            v += permutation_element(digit, base, p) * weight;
+            weight *= inv_base;
+        }
+        return v;
+    }
+};
+
+// Padded, Owen-scrambled Sobol: each dimension pair takes its points from the first two
+// Sobol dimensions, a (0,2)-sequence that is well stratified at every power-of-two prefix.
+// The sample order is permuted per pixel and pair, and the values Owen-scrambled per pixel and
+// dimension, so pairs are decorrelated from each other and from neighbouring pixels.
+class sobol_sampler : public dimension_sampler {
+  public:
+    using dimension_sampler::dimension_sampler;
+
+  protected:
+    double sample(int d) const override {
+        int pair = d / 2;
+        uint32_t index = permutation_element(sample_index % sample_count, sample_count,
+                                             pixel_hash(1000 + pair));
+        uint32_t v = (d % 2 == 0) ? reverse_bits(index) : sobol_dimension_1(index);
+        return owen_scramble(v, pixel_hash(d)) * (1.0 / 4294967296.0);
+    }
+
+    static uint32_t sobol_dimension_1(uint32_t index) {
+        // Second Sobol dimension (primitive polynomial x + 1): direction number k is the
+        // previous one xored with itself shifted right by one.
+        uint32_t v = 0, direction = 0x80000000u;
+        for (; index; index >>= 1, direction ^= direction >> 1)
+            if (index & 1)
+                v ^= direction;
+        return v;
+    }
+};
+
+// Blue-noise threshold mask (void-and-cluster, Ulichney 1993), `size` x `size` and tileable:
+// every value 0 .. size*size-1 appears once, and each prefix of the ranking is spread evenly.
+inline std::vector<float> make_blue_noise_mask(int size, uint64_t seed) {
+    int n = size * size;
+    const double sigma = 1.9;
+
+    // Gaussian energy of a point at toroidal offset (dx, dy).
+    std::vector<double> kernel(n);
+    for (int dy = 0; dy < size; dy++) {
+        for (int dx = 0; dx < size; dx++) {
+            int ex = std::min(dx, size - dx), ey = std::min(dy, size - dy);
+            kernel[dy * size + dx] = std::exp(-(ex*ex + ey*ey) / (2 * sigma * sigma));
+        }
+    }
+
+    std::vector<char> pattern(n, 0);
+    std::vector<double> energy(n, 0.0);
+    auto splat = [&](std::vector<double>& e, int p, double sign) {
+        int px = p % size, py = p / size;
+        for (int y = 0; y < size; y++) {
+            int ky = ((y - py + size) % size) * size;
+            for (int x = 0; x < size; x++)
+                e[y * size + x] += sign * kernel[ky + (x - px + size) % size];
+        }
+    };
+    auto extreme = [&](const std::vector<char>& pat, const std::vector<double>& e, char value, bool largest) {
+        // Tightest cluster (largest energy among ones) or largest void (smallest among zeros).
+        int best = -1;
+        for (int p = 0; p < n; p++) {
+            if (pat[p] != value) continue;
+            if (best < 0 || (largest ? e[p] > e[best] : e[p] < e[best]))
+                best = p;
+        }
+        return best;
+    };
+
+    // Initial binary pattern: a tenth of the cells at random, then relaxed by moving the point
+    // in the tightest cluster to the largest void until that changes nothing.
+    pcg32 rng(seed);
+    int ones = n / 10;
+    for (int placed = 0; placed < ones; ) {
+        int p = static_cast<int>(rng.next_uint() % static_cast<uint32_t>(n));
+        if (pattern[p]) continue;
+        pattern[p] = 1;
+        splat(energy, p, 1);
+        placed++;
+    }
+    for (int iteration = 0; iteration < 4 * n; iteration++) {
+        int cluster = extreme(pattern, energy, 1, true);
+        pattern[cluster] = 0;
+        splat(energy, cluster, -1);
+        int hole = extreme(pattern, energy, 0, false);
+        pattern[hole] = 1;
+        splat(energy, hole, 1);
+        if (hole == cluster)
+            break;
+    }
+
+    std::vector<int> rank(n, 0);
+
+    // Phase 1: rank the initial points by repeatedly removing the tightest cluster.
+    {
+        std::vector<char> pat = pattern;
+        std::vector<double> e = energy;
+        for (int r = ones - 1; r >= 0; r--) {
+            int cluster = extreme(pat, e, 1, true);
+            pat[cluster] = 0;
+            splat(e, cluster, -1);
+            rank[cluster] = r;
+        }
+    }
+
+    // Phases 2 and 3: fill the largest void until every cell is ranked.
+    for (int r = ones; r < n; r++) {
+        int hole = extreme(pattern, energy, 0, false);
+        pattern[hole] = 1;
+        splat(energy, hole, 1);
+        rank[hole] = r;
+    }
+
+    std::vector<float> mask(n);
+    for (int p = 0; p < n; p++)
+        mask[p] = (rank[p] + 0.5f) / n;
+    return mask;
+}
+
+// Blue-noise tiled: a tileable blue-noise mask gives every pixel a starting point, and the
+// sample index advances it along an additive recurrence (the R2 sequence). Each dimension pair
+// reads the mask at its own toroidal offset. Error at low sample counts is pushed to high
+// spatial frequencies, where it reads as fine grain instead of blotches.
+class blue_noise_sampler : public dimension_sampler {
+  public:
+    static const int mask_size = 64;
+
+    explicit blue_noise_sampler(uint64_t seed) : dimension_sampler(seed), mask(shared_mask()) {}
+
+  protected:
+    double sample(int d) const override {
+        uint32_t h = dimension_hash(d);
+        int x = (px + static_cast<int>(h & 0xffff)) & (mask_size - 1);
+        int y = (py + static_cast<int>(h >> 16)) & (mask_size - 1);
+        double alpha = (d % 2 == 0) ? 0.7548776662466927 : 0.5698402909980532;
+        double v = mask[y * mask_size + x] + alpha * sample_index;
+        return v - std::floor(v);
+    }
+
+  private:
+    const std::vector<float>& mask;
+
+    static const std::vector<float>& shared_mask() {
+        // Built on first use and shared by every thread; it takes a few tens of milliseconds.
+        static const std::vector<float> m = make_blue_noise_mask(mask_size, 0x5eed);
+        return m;
+    }
+};
+
+inline std::unique_ptr<sampler> make_sampler(sampler_type type, uint64_t seed) {
+    // Returns null for independent sampling, which is the plain thread_rng() stream.
+    switch (type) {
+        case sampler_type::stratified: return std::unique_ptr<sampler>(new stratified_sampler(seed));
+        case sampler_type::halton:     return std::unique_ptr<sampler>(new halton_sampler(seed));
+        case sampler_type::sobol:      return std::unique_ptr<sampler>(new sobol_sampler(seed));
+        case sampler_type::blue_noise: return std::unique_ptr<sampler>(new blue_noise_sampler(seed));
+        default:                       return nullptr;
+    }
+}
+
+// Installs a sampler of the given type on the calling thread for the lifetime of the scope.
+class sampler_scope {
+  public:
+    sampler_scope(sampler_type type, uint64_t seed)
+      : owned(make_sampler(type, seed)), previous(thread_sampler()) {
+        thread_sampler() = owned.get();
+    }
+    ~sampler_scope() { thread_sampler() = previous; }
+
+    sampler_scope(const sampler_scope&) = delete;
+    sampler_scope& operator=(const sampler_scope&) = delete;
+
+  private:
+    std::unique_ptr<sampler> owned;
+    sampler* previous;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "rtweekend.h"
+
+#include "box.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "rectangles.h"
+#include "sphere.h"
+
+#include <vector>
+
+// Scene container that stores primitives by value, one contiguous array per primitive type.
+// The intersection loop walks each array with a qualified (non-virtual) call to the concrete
+// hit function, so there is no pointer chasing and no indirect branch per primitive. Shapes
+// without a typed array still go through the `hittable` interface in `others`. `cube` keeps its
+// six faces in one, so every BVH leaf that holds a cube tests them this way.
+class scene : public hittable {
+  public:
+    scene() {}
+
+    void add(const sphere& s)  { spheres.push_back(s);  grow(s.bounding_box()); }
+    void add(const yz_rect& q) { yz_rects.push_back(q); grow(q.bounding_box()); }
+    void add(const xz_rect& q) { xz_rects.push_back(q); grow(q.bounding_box()); }
+    void add(const xy_rect& q) { xy_rects.push_back(q); grow(q.bounding_box()); }
+    void add(const box& b)     { boxes.push_back(b);    grow(b.bounding_box()); }
+
+    void add(shared_ptr<hittable> object) {
+        others.add(object);
+        grow(object->bounding_box());
+    }
+
+    void clear() {
+        spheres.clear();
+        yz_rects.clear();
+        xz_rects.clear();
+        xy_rects.clear();
+        boxes.clear();
+        others.clear();
+        bbox = aabb();
+    }
+
+    size_t size() const {
+        return spheres.size() + yz_rects.size() + xz_rects.size() + xy_rects.size()
+             + boxes.size() + others.objects.size();
+    }
+
+    virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return intersect_and_finalize(r, ray_t, rec);
+    }
+
+    virtual bool intersect(const ray& r, interval ray_t, hit_record& rec) const override {
+        bool hit_anything = false;
+
+        hit_anything |= hit_all(spheres,  r, ray_t, rec);
+        hit_anything |= hit_all(yz_rects, r, ray_t, rec);
+        hit_anything |= hit_all(xz_rects, r, ray_t, rec);
+        hit_anything |= hit_all(xy_rects, r, ray_t, rec);
+        hit_anything |= hit_all(boxes,    r, ray_t, rec);
+
+        if (!others.objects.empty() && others.intersect(r, ray_t, rec)) {
+            hit_anything = true;
+        }
+
+        return hit_anything;
+    }
+
+    virtual bool occluded(const ray& r, interval ray_t) const override {
+        return occluded_any(spheres, r, ray_t) || occluded_any(yz_rects, r, ray_t)
+            || occluded_any(xz_rects, r, ray_t) || occluded_any(xy_rects, r, ray_t)
+            || occluded_any(boxes, r, ray_t) || others.occluded(r, ray_t);
+    }
+
+    virtual aabb bounding_box() const override { return bbox; }
+
+    virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override {
+        hit_packet_all(spheres,  rays, active, hits);
+        hit_packet_all(yz_rects, rays, active, hits);
+        hit_packet_all(xz_rects, rays, active, hits);
+        hit_packet_all(xy_rects, rays, active, hits);
+        hit_packet_all(boxes,    rays, active, hits);
+        others.hit_packet(rays, active, hits);
+    }
+
+  public:
+    std::vector<sphere>  spheres;
+    std::vector<yz_rect> yz_rects;
+    std::vector<xz_rect> xz_rects;
+    std::vector<xy_rect> xy_rects;
+    std::vector<box>     boxes;
+    hittable_list        others;  // Custom shapes, reached through the virtual interface
+
+  private:
+    aabb bbox;
+
+    void grow(const aabb& b) { bbox = aabb(bbox, b); }
+
+    template <typename T>
+    static bool hit_all(const std::vector<T>& prims, const ray& r, interval& ray_t, hit_record& rec) {
+        // Tests every primitive of one type, shrinking ray_t.max to the closest hit so far.
+        bool hit_anything = false;
+        for (const auto& prim : prims) {
+            if (prim.T::intersect(r, ray_t, rec)) {
+                hit_anything = true;
+                ray_t.max = rec.t;
+            }
+        }
+        return hit_anything;
+    }
+
+    template <typename T>
+    static bool occluded_any(const std::vector<T>& prims, const ray& r, const interval& ray_t) {
+        for (const auto& prim : prims)
+            if (prim.T::occluded(r, ray_t))
+                return true;
+        return false;
+    }
+
+    template <typename T>
+    static void hit_packet_all(const std::vector<T>& prims, const ray_packet& rays, vmask active,
+                               packet_hit& hits) {
+        for (const auto& prim : prims)
+            prim.T::hit_packet(rays, active, hits);
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+
+#include "batch.h"
+#include "box.h"
+#include "camera.h"
+#include "cube.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+
+#include <cmath>
+#include <vector>
+
+// Scenes shared by the renderer and the benchmarks. Each adds its objects to `world` and sets up
+// `cam` to view them; the caller builds the acceleration structure and picks the render options.
+
+inline void cube_field_scene(hittable_list& world, camera& cam) {
+    // The cube field: a ground slab, three large cubes (glass, diffuse, metal) and a grid of
+    // small cubes of random materials, drawn from the calling thread's random stream.
+    // Piso: un cubo gigante que simula un plano
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<cube>(
+        point3(-1000, -1, -1000),
+        point3(1000, 0, 1000),
+        ground_material
+    ));
+
+    // Centros de cubos especiales para evitar colisiones:
+    // Cubo dielctrico: de (-1,0,-1) a (1,2,1) => centro (0,1,0), medio lado = 1.
+    // Cubo difuso: de (-4,0,-1) a (-2,2,1) => centro (-3,1,0), medio lado = 1.
+    // Cubo metlico: de (4,0,-1) a (6,2,1) => centro (5,1,0), medio lado = 1.
+    std::vector<point3> specialCenters;
+    specialCenters.push_back(point3(0, 1, 0));
+    specialCenters.push_back(point3(-3, 1, 0));
+    specialCenters.push_back(point3(5, 1, 0));
+
+    // Vector para almacenar los centros de los cubos pequeos ya colocados
+    std::vector<point3> placedCenters;
+
+    // Los cubos pequeos se guardan como cajas y se agrupan en lotes de 8 (box_batch),
+    // que se intersectan con una sola pasada SIMD en las hojas del BVH
+    std::vector<box> smallCubes;
+
+    // Bucle similar al original, con muchos pequeos cubos
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            // Evitamos colisiones con cubos especiales
+            bool collides = false;
+            for (const auto& sp_center : specialCenters) {
+                if (std::fabs(center.x() - sp_center.x()) < 1.2 &&
+                    std::fabs(center.z() - sp_center.z()) < 1.2) {
+                    collides = true;
+                    break;
+                }
+            }
+            // Evitar colisiones con cubos pequeos ya colocados (lado 0.4 => separacin mnima en x y z: 0.4)
+            for (const auto& placed : placedCenters) {
+                if (std::fabs(center.x() - placed.x()) < 0.4 &&
+                    std::fabs(center.z() - placed.z()) < 0.4) {
+                    collides = true;
+                    break;
+                }
+            }
+            if (collides) continue;
+
+            // Asignar materiales con probabilidad igual (1/3 cada uno)
+            shared_ptr<material> cube_material;
+            if (choose_mat < 1.0 / 3) {
+                // Difuso
+                auto albedo = color::random() * color::random();
+                cube_material = make_shared<lambertian>(albedo);
+            }
+            else if (choose_mat < 2.0 / 3) {
+                // Metlico
+                auto albedo = color::random(0.5, 1);
+                auto fuzz = random_double(0, 0.5);
+                cube_material = make_shared<metal>(albedo, fuzz);
+            }
+            else {
+                // Dielctrico (vidrio)
+                cube_material = make_shared<dielectric>(1.5);
+            }
+            // Crear el cubo pequeo (lado = 0.4, extendido 0.2 en cada direccin)
+            smallCubes.push_back(box(
+                center - vec3(0.2, 0.2, 0.2),
+                center + vec3(0.2, 0.2, 0.2),
+                cube_material
+            ));
+            placedCenters.push_back(center);
+        }
+    }
+    for (const auto& batch : make_batches<box_batch>(smallCubes))
+        world.add(batch);
+
+    // Cubos especiales para ver claramente los materiales:
+
+    // Cubo dielctrico (vidrio)
+    auto material1 = make_shared<dielectric>(1.5);
+    world.add(make_shared<cube>(
+        point3(-1, 0, -1),
+        point3(1, 2, 1),
+        material1
+    ));
+
+    // Cubo difuso
+    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
+    world.add(make_shared<cube>(
+        point3(-4, 0, -1),
+        point3(-2, 2, 1),
+        material2
+    ));
+
+    // Cubo metlico
+    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
+    world.add(make_shared<cube>(
+        point3(4, 0, -1),
+        point3(6, 2, 1),
+        material3
+    ));
+
+    // Configuracin de la cmara
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 500;
+    cam.samples_per_pixel = 50;
+    cam.max_depth = 25;
+    cam.packet_primary_rays = true;
+
+    cam.vfov = 20;
+    cam.lookfrom = point3(13, 2, 3);
+    cam.lookat = point3(0, 0, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+}
+
+inline void single_cube_scene(hittable_list& world, camera& cam) {
+    // The scene of "Raytracing Cubo (sin diligent)": one diffuse cube on a large sphere.
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    auto cube_material = make_shared<lambertian>(color(0.7, 0.3, 0.3));
+    world.add(make_shared<cube>(
+        point3(-1, 0, -1),
+        point3(1, 2, 1),
+        cube_material
+    ));
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 720;
+    cam.samples_per_pixel = 100;
+    cam.max_depth = 20;
+
+    cam.vfov = 30;
+    cam.lookfrom = point3(8, 4, 8);
+    cam.lookat = point3(0, 1, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    cam.defocus_angle = 0.3;
+    cam.focus_dist = 12.0;
+}
+
+inline void spheres_and_cubes_scene(hittable_list& world, camera& cam) {
+    // Spheres and cubes side by side, after the layout of "Raytracing Esferas y Cubos Diligent":
+    // a row of three spheres with a cube between each pair, so every material shows up on both
+    // kinds of primitive. Draws no random numbers.
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+
+    // Esferas: vidrio, difusa y metlica
+    world.add(make_shared<sphere>(point3(0, 1, -6), 1, make_shared<dielectric>(1.5)));
+    world.add(make_shared<sphere>(point3(0, 1, 0), 1, make_shared<lambertian>(color(0.1, 0.2, 0.5))));
+    world.add(make_shared<sphere>(point3(0, 1, 6), 1, make_shared<metal>(color(0.8, 0.6, 0.2), 0.1)));
+
+    // Cubos entre las esferas: metlico y difuso
+    world.add(make_shared<cube>(
+        point3(-1, 0, -4),
+        point3(1, 2, -2),
+        make_shared<metal>(color(0.7, 0.7, 0.7), 0.0)
+    ));
+    world.add(make_shared<cube>(
+        point3(-1, 0, 2),
+        point3(1, 2, 4),
+        make_shared<lambertian>(color(0.7, 0.3, 0.3))
+    ));
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 50;
+    cam.max_depth = 25;
+
+    cam.vfov = 40;
+    cam.lookfrom = point3(13, 3, 2);
+    cam.lookat = point3(0, 1, 0);
+    cam.vup = vec3(0, 1, 0);
+}
+
+#endif
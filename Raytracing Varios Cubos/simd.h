@@ -0,0 +1,155 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin wrapper over the widest float vector the build targets: 8 lanes with AVX2, 4 lanes with
+// SSE, and a plain 4-element array elsewhere. Packet code is written once against `vfloat`
+// and `vmask` and compiles to whichever is available.
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RT_SIMD_AVX 1
+#define RT_SIMD_WIDTH 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RT_SIMD_SSE 1
+#define RT_SIMD_WIDTH 4
+#else
+#define RT_SIMD_WIDTH 4
+#endif
+
+const int simd_width = RT_SIMD_WIDTH;
+
+#if defined(RT_SIMD_AVX)
+
+struct vmask  { __m256 v; };
+struct vfloat {
+    __m256 v;
+    vfloat() {}
+    vfloat(__m256 x) : v(x) {}
+    vfloat(float x) : v(_mm256_set1_ps(x)) {}
+    static vfloat load(const float* p) { return _mm256_load_ps(p); }
+    static vfloat loadu(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_store_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a.v, b.v); }
+inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a.v); }
+inline vfloat vabs(vfloat a)  { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+
+inline vmask operator<(vfloat a, vfloat b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline vmask operator>(vfloat a, vfloat b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline vmask operator&(vmask a, vmask b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline vmask operator|(vmask a, vmask b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline vmask andnot(vmask a, vmask b) { return { _mm256_andnot_ps(b.v, a.v) }; }  // a & ~b
+
+inline vfloat select(vmask m, vfloat a, vfloat b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+inline int  bits(vmask m) { return _mm256_movemask_ps(m.v); }
+inline vmask mask_from_bits(int b) {
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i set = _mm256_and_si256(_mm256_set1_epi32(b), lane_bits);
+    return { _mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lane_bits)) };
+}
+
+#elif defined(RT_SIMD_SSE)
+
+struct vmask  { __m128 v; };
+struct vfloat {
+    __m128 v;
+    vfloat() {}
+    vfloat(__m128 x) : v(x) {}
+    vfloat(float x) : v(_mm_set1_ps(x)) {}
+    static vfloat load(const float* p) { return _mm_load_ps(p); }
+    static vfloat loadu(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_store_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a.v, b.v); }
+inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a.v); }
+inline vfloat vabs(vfloat a)  { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+inline vmask operator<(vfloat a, vfloat b)  { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline vmask operator>(vfloat a, vfloat b)  { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline vmask operator&(vmask a, vmask b) { return { _mm_and_ps(a.v, b.v) }; }
+inline vmask operator|(vmask a, vmask b) { return { _mm_or_ps(a.v, b.v) }; }
+inline vmask andnot(vmask a, vmask b) { return { _mm_andnot_ps(b.v, a.v) }; }  // a & ~b
+
+inline vfloat select(vmask m, vfloat a, vfloat b) {
+    return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+}
+inline int  bits(vmask m) { return _mm_movemask_ps(m.v); }
+inline vmask mask_from_bits(int b) {
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    __m128i set = _mm_and_si128(_mm_set1_epi32(b), lane_bits);
+    return { _mm_castsi128_ps(_mm_cmpeq_epi32(set, lane_bits)) };
+}
+
+#else
+
+// Portable fallback: same interface, one lane at a time.
+struct vmask  { bool v[RT_SIMD_WIDTH]; };
+struct vfloat {
+    float v[RT_SIMD_WIDTH];
+    vfloat() {}
+    vfloat(float x) { for (int k = 0; k < RT_SIMD_WIDTH; k++) v[k] = x; }
+    static vfloat load(const float* p) { vfloat r; for (int k = 0; k < RT_SIMD_WIDTH; k++) r.v[k] = p[k]; return r; }
+    static vfloat loadu(const float* p) { return load(p); }
+    void store(float* p) const { for (int k = 0; k < RT_SIMD_WIDTH; k++) p[k] = v[k]; }
+};
+
+#define RT_SIMD_LANEWISE(expr) for (int k = 0; k < RT_SIMD_WIDTH; k++) r.v[k] = (expr); return r;
+inline vfloat operator+(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] + b.v[k]) }
+inline vfloat operator-(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] - b.v[k]) }
+inline vfloat operator*(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] * b.v[k]) }
+inline vfloat operator/(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] / b.v[k]) }
+inline vfloat vmin(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] < b.v[k] ? a.v[k] : b.v[k]) }
+inline vfloat vmax(vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(a.v[k] > b.v[k] ? a.v[k] : b.v[k]) }
+inline vfloat vsqrt(vfloat a) { vfloat r; RT_SIMD_LANEWISE(std::sqrt(a.v[k])) }
+inline vfloat vabs(vfloat a)  { vfloat r; RT_SIMD_LANEWISE(std::fabs(a.v[k])) }
+inline vmask operator<(vfloat a, vfloat b)  { vmask r; RT_SIMD_LANEWISE(a.v[k] < b.v[k]) }
+inline vmask operator<=(vfloat a, vfloat b) { vmask r; RT_SIMD_LANEWISE(a.v[k] <= b.v[k]) }
+inline vmask operator>(vfloat a, vfloat b)  { vmask r; RT_SIMD_LANEWISE(a.v[k] > b.v[k]) }
+inline vmask operator>=(vfloat a, vfloat b) { vmask r; RT_SIMD_LANEWISE(a.v[k] >= b.v[k]) }
+inline vmask operator&(vmask a, vmask b) { vmask r; RT_SIMD_LANEWISE(a.v[k] && b.v[k]) }
+inline vmask operator|(vmask a, vmask b) { vmask r; RT_SIMD_LANEWISE(a.v[k] || b.v[k]) }
+inline vmask andnot(vmask a, vmask b) { vmask r; RT_SIMD_LANEWISE(a.v[k] && !b.v[k]) }
+inline vfloat select(vmask m, vfloat a, vfloat b) { vfloat r; RT_SIMD_LANEWISE(m.v[k] ? a.v[k] : b.v[k]) }
+#undef RT_SIMD_LANEWISE
+
+inline int bits(vmask m) {
+    int b = 0;
+    for (int k = 0; k < RT_SIMD_WIDTH; k++) b |= m.v[k] ? (1 << k) : 0;
+    return b;
+}
+inline vmask mask_from_bits(int b) {
+    vmask r;
+    for (int k = 0; k < RT_SIMD_WIDTH; k++) r.v[k] = (b >> k) & 1;
+    return r;
+}
+
+#endif
+
+inline bool any(vmask m) { return bits(m) != 0; }
+
+inline int lane_count(vmask m) {
+    int n = 0;
+    for (int b = bits(m); b; b &= b - 1) n++;
+    return n;
+}
+
+#endif
@@ -2,22 +2,39 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "material.h"
+#include "stats.h"
 
 class sphere : public hittable{
     public:
         sphere() {}
-        sphere(point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat(m) {};
+        sphere(point3 cen, double r, shared_ptr<material> m)
+          : center(cen), radius(r), mat(scene_materials().add(m)) {};
 
-        virtual bool hit(
+        virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return intersect_and_finalize(r, ray_t, rec);
+        }
+
+        virtual bool intersect(
             const ray& r, interval ray_t, hit_record& rec) const override;
 
+        virtual void finalize(const ray& r, hit_record& rec) const override;
+
+        virtual aabb bounding_box() const override {
+            auto rvec = vec3(radius, radius, radius);
+            return aabb(center - rvec, center + rvec);
+        }
+
+        virtual void hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const override;
+
     public:
         point3 center;
         double radius;
-        shared_ptr<material> mat;
+        const material* mat;
 };
 
-bool sphere::hit(const ray& r, interval ray_t, hit_record& rec) const {
+bool sphere::intersect(const ray& r, interval ray_t, hit_record& rec) const {
+    RT_STAT(primitive_tests);
     vec3 oc = r.origin() - center;
     auto a = r.direction().length_squared();
     auto half_b = dot(oc, r.direction());
@@ -37,13 +54,52 @@ bool sphere::hit(const ray& r, interval ray_t, hit_record& rec) const {
     }
 
     rec.t = root;
+    rec.prim = this;
+    return true;
+}
+
+void sphere::finalize(const ray& r, hit_record& rec) const {
     rec.p = r.at(rec.t);
     vec3 outward_normal =(rec.p - center) / radius; 
     rec.set_face_normal(r, outward_normal);
 
     rec.mat = mat;
+}
 
-    return true;
+void sphere::hit_packet(const ray_packet& rays, vmask active, packet_hit& hits) const {
+    // Same quadratic as hit(), in float. The discriminant is taken as a*(r^2 - |f|^2), where f
+    // is the offset from the center to the ray's closest approach; unlike half_b^2 - a*c it
+    // does not cancel catastrophically for large spheres such as a ground sphere.
+    RT_STAT_ADD(primitive_tests, lane_count(active));
+    vfloat ocx = rays.origin(0) - vfloat(static_cast<float>(center.x()));
+    vfloat ocy = rays.origin(1) - vfloat(static_cast<float>(center.y()));
+    vfloat ocz = rays.origin(2) - vfloat(static_cast<float>(center.z()));
+    vfloat dx = rays.direction(0), dy = rays.direction(1), dz = rays.direction(2);
+
+    vfloat a = dx*dx + dy*dy + dz*dz;
+    vfloat half_b = ocx*dx + ocy*dy + ocz*dz;
+    vfloat s = half_b / a;
+    vfloat fx = ocx - s*dx, fy = ocy - s*dy, fz = ocz - s*dz;
+    vfloat discriminant = a * (vfloat(static_cast<float>(radius*radius)) - (fx*fx + fy*fy + fz*fz));
+
+    // |f|^2 carries an error of about |oc| * radius float ulps, so a ray whose discriminant is
+    // within that of zero grazes the silhouette and is kept, marked uncertain.
+    vfloat r(static_cast<float>(std::fabs(radius)));
+    vfloat oc_length = vsqrt(ocx*ocx + ocy*ocy + ocz*ocz);
+    vfloat pad = a * vfloat(1e-5f) * (vfloat(1.0f) + r * (r + oc_length));
+    vmask real = active & (discriminant >= vfloat(0.0f) - pad);
+    if (!any(real))
+        return;
+
+    vfloat sqrtd = vsqrt(vmax(discriminant, vfloat(0.0f)));
+    vfloat t_min(rays.t_min), t_max = hits.t_limit();
+    vfloat near_root = (vfloat(0.0f) - half_b - sqrtd) / a;
+    vfloat far_root  = (sqrtd - half_b) / a;
+
+    vmask near_ok = real & (near_root > t_min) & (near_root < t_max);
+    vmask far_ok  = andnot(real & (far_root > t_min) & (far_root < t_max), near_ok);
+    hits.mark_uncertain((near_ok | far_ok) & (discriminant < pad));
+    hits.record(near_ok | far_ok, select(near_ok, near_root, far_root), this);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Render counters, compiled in with -DRT_STATS (the CMake option of the same name). Each
+// thread counts into its own block, so counting costs one thread-local increment and never
+// contends; render_stats_registry::collect() adds the blocks up after a render. Without RT_STATS the
+// RT_STAT macros expand to nothing. Include it after hittable.h.
+
+#ifdef RT_STATS
+
+#include "material.h"
+
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+struct render_stats {
+    long long primary_rays = 0;      // Camera rays traced
+    long long secondary_rays = 0;    // Bounce rays traced
+    long long primitive_tests = 0;   // Ray-primitive tests (each packet lane and batch lane counts)
+    long long bvh_nodes = 0;         // BVH nodes visited (bvh_node and bvh4 alike)
+    long long packet_retraces = 0;   // Packet lanes too close to call in float, traced again in double
+    long long scatters[material_kind_count] = {};  // scatter() calls, by material_kind
+
+    // Why paths ended
+    long long paths_escaped = 0;     // Missed everything and took the background
+    long long paths_absorbed = 0;    // scatter() returned false
+    long long paths_max_depth = 0;   // Cut by max_depth
+    long long paths_dim = 0;         // Throughput fell below min_throughput
+    long long paths_roulette = 0;    // Lost at Russian roulette
+
+    void add(const render_stats& other) {
+        primary_rays += other.primary_rays;
+        secondary_rays += other.secondary_rays;
+        primitive_tests += other.primitive_tests;
+        bvh_nodes += other.bvh_nodes;
+        packet_retraces += other.packet_retraces;
+        for (int k = 0; k < material_kind_count; k++)
+            scatters[k] += other.scatters[k];
+        paths_escaped += other.paths_escaped;
+        paths_absorbed += other.paths_absorbed;
+        paths_max_depth += other.paths_max_depth;
+        paths_dim += other.paths_dim;
+        paths_roulette += other.paths_roulette;
+    }
+};
+
+// Every thread's counter block, plus the totals of threads that have exited.
+class render_stats_registry {
+  public:
+    static render_stats_registry& get() {
+        static render_stats_registry registry;
+        return registry;
+    }
+
+    void enroll(render_stats* block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.push_back(block);
+    }
+
+    void retire(render_stats* block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.add(*block);
+        blocks.erase(std::remove(blocks.begin(), blocks.end(), block), blocks.end());
+    }
+
+    render_stats collect() {
+        // Totals so far. Call it while no thread is counting (between renders).
+        std::lock_guard<std::mutex> lock(mutex);
+        render_stats total = retired;
+        for (auto block : blocks)
+            total.add(*block);
+        return total;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired = render_stats();
+        for (auto block : blocks)
+            *block = render_stats();
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<render_stats*> blocks;
+    render_stats retired;
+};
+
+inline render_stats& thread_stats() {
+    // The calling thread's counter block, enrolled with the registry on first use and folded
+    // into its retired totals when the thread exits.
+    struct enrolled_block {
+        render_stats stats;
+        enrolled_block()  { render_stats_registry::get().enroll(&stats); }
+        ~enrolled_block() { render_stats_registry::get().retire(&stats); }
+    };
+    thread_local enrolled_block block;
+    return block.stats;
+}
+
+inline void write_render_stats_json(std::ostream& out, const render_stats& s, double seconds) {
+    // One JSON object with the counters, the wall time and the derived rates.
+    static const char* kinds[material_kind_count] = { "lambertian", "metal", "dielectric", "other" };
+    long long rays = s.primary_rays + s.secondary_rays;
+    long long paths = s.paths_escaped + s.paths_absorbed + s.paths_max_depth + s.paths_dim + s.paths_roulette;
+
+    out << "{\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"mrays_per_second\": " << (seconds > 0 ? rays / seconds / 1e6 : 0.0) << ",\n"
+        << "  \"primary_rays\": " << s.primary_rays << ",\n"
+        << "  \"secondary_rays\": " << s.secondary_rays << ",\n"
+        << "  \"bounces_per_path\": " << (paths ? static_cast<double>(s.secondary_rays) / paths : 0.0) << ",\n"
+        << "  \"primitive_tests\": " << s.primitive_tests << ",\n"
+        << "  \"primitive_tests_per_ray\": " << (rays ? static_cast<double>(s.primitive_tests) / rays : 0.0) << ",\n"
+        << "  \"bvh_nodes\": " << s.bvh_nodes << ",\n"
+        << "  \"bvh_nodes_per_ray\": " << (rays ? static_cast<double>(s.bvh_nodes) / rays : 0.0) << ",\n"
+        << "  \"packet_retraces\": " << s.packet_retraces << ",\n"
+        << "  \"scatters\": {";
+    for (int k = 0; k < material_kind_count; k++)
+        out << (k ? ", " : " ") << '"' << kinds[k] << "\": " << s.scatters[k];
+    out << " },\n"
+        << "  \"paths_ended\": { \"escaped\": " << s.paths_escaped
+        << ", \"absorbed\": " << s.paths_absorbed
+        << ", \"max_depth\": " << s.paths_max_depth
+        << ", \"min_throughput\": " << s.paths_dim
+        << ", \"roulette\": " << s.paths_roulette << " }\n"
+        << "}\n";
+}
+
+#define RT_STAT(counter)        (++thread_stats().counter)
+#define RT_STAT_ADD(counter, n) (thread_stats().counter += (n))
+
+#else
+
+#define RT_STAT(counter)        ((void)0)
+#define RT_STAT_ADD(counter, n) ((void)0)
+
+#endif
+
+#endif
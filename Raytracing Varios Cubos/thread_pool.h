@@ -0,0 +1,213 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads with one task deque per worker. A worker pops tasks
+// from the back of its own deque and, when that runs dry, steals from the front of the
+// others, so uneven tiles (sky vs. glass) keep every core busy until the image is done. Only
+// the workers run tasks: a pool of n threads keeps exactly n cores busy while the thread that
+// submitted the work sleeps in wait().
+class thread_pool {
+  public:
+    explicit thread_pool(int num_threads = 0) {
+        if (num_threads <= 0)
+            num_threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (num_threads <= 0)
+            num_threads = 1;
+
+        for (int i = 0; i < num_threads; i++)
+            queues.emplace_back(new work_queue);
+        for (int i = 0; i < num_threads; i++)
+            workers.emplace_back(&thread_pool::worker_loop, this, i);
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void submit(std::function<void()> task) {
+        // Tasks spawned by a worker stay on its own deque; outside submissions are dealt
+        // round-robin so the initial load starts out balanced.
+        int q = (current_pool() == this) ? current_worker()
+              : static_cast<int>(next_queue++ % queues.size());
+
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        wake.notify_one();
+    }
+
+    void wait() {
+        // Blocks until every submitted task has finished. Call it from outside the pool;
+        // inside a task, wait on a task_group instead.
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+    bool is_worker() const {
+        // Whether the calling thread is one of this pool's workers.
+        return current_pool() == this;
+    }
+
+    bool run_one() {
+        // Runs one queued task on the calling worker, if there is any. Returns whether it did.
+        int self = current_worker();
+        std::function<void()> task;
+        if (!try_pop(self, task) && !try_steal(self, task))
+            return false;
+        run(task);
+        return true;
+    }
+
+  private:
+    struct work_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<work_queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> pending{0};
+    std::atomic<unsigned> next_queue{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;   // Workers sleep on it while there is nothing to run
+    std::mutex idle_mutex;
+    std::condition_variable idle;   // wait() sleeps on it until pending reaches 0
+    bool stopping = false;
+
+    static const thread_pool*& current_pool() {
+        static thread_local const thread_pool* pool = nullptr;
+        return pool;
+    }
+
+    static int& current_worker() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    bool try_pop(int q, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(queues[q]->mutex);
+        if (queues[q]->tasks.empty())
+            return false;
+        task = std::move(queues[q]->tasks.back());
+        queues[q]->tasks.pop_back();
+        return true;
+    }
+
+    bool try_steal(int thief, std::function<void()>& task) {
+        int n = static_cast<int>(queues.size());
+        for (int k = 1; k <= n; k++) {
+            auto& victim = *queues[(thief + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(std::function<void()>& task) {
+        task();
+        if (--pending == 0) {
+            // Taking the lock orders this notify after a waiter's check of `pending`.
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            idle.notify_all();
+        }
+    }
+
+    void worker_loop(int index) {
+        current_pool() = this;
+        current_worker() = index;
+
+        while (true) {
+            std::function<void()> task;
+            if (try_pop(index, task) || try_steal(index, task)) {
+                run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            if (stopping)
+                return;
+            if (!has_work())
+                wake.wait(lock);
+        }
+    }
+
+    bool has_work() {
+        for (auto& q : queues) {
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if (!q->tasks.empty())
+                return true;
+        }
+        return false;
+    }
+};
+
+// Set of tasks that can be waited on independently of the rest of the pool's work. Tasks may
+// spawn and wait on groups of their own (recursive builds): a waiting worker keeps executing
+// queued tasks while there are any, so nesting never starves the pool, and then sleeps until
+// the group's last task, already running elsewhere, finishes. A thread outside the pool only
+// sleeps.
+class task_group {
+  public:
+    explicit task_group(thread_pool& p) : pool(p) {}
+    ~task_group() { wait(); }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    void run(std::function<void()> task) {
+        pending++;
+        pool.submit([this, task] {
+            task();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_all();
+        });
+    }
+
+    void wait() {
+        if (pool.is_worker())
+            while (pending > 0 && pool.run_one()) {}
+
+        // Always finish under the lock, so the last task has released it before the group
+        // can be destroyed.
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+  private:
+    thread_pool& pool;
+    std::atomic<int> pending{0};
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+#endif
@@ -107,16 +107,21 @@ std::ostream& operator<<(std::ostream &out, const vec3 &v) {
     return v / v.length();
 }
 
-vec3 random_in_unit_sphere() {
-    while (true) {
-        auto p = vec3::random(-1,1);
-        if (p.length_squared() < 1)
-            return p;
-    }
-}
+// The samplers below map uniform randoms straight onto their domain instead of rejection
+// sampling a bounding square or cube, so each call costs a fixed number of random draws.
 
 vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+    // Uniform on the sphere: z is uniform in [-1,1] (Archimedes), the azimuth uniform in [0,2pi).
+    auto z = 1 - 2*random_double();
+    double sin_phi, cos_phi;
+    sin_cos_turns(random_double(), sin_phi, cos_phi);
+    auto r = sqrt(fmax(0.0, 1 - z*z));
+    return vec3(r*cos_phi, r*sin_phi, z);
+}
+
+vec3 random_in_unit_sphere() {
+    // A uniform direction scaled by the cube root of a uniform radius fills the ball uniformly.
+    return std::cbrt(random_double()) * random_unit_vector();
 }
 
 vec3 random_on_hemisphere(const vec3& normal) {
@@ -139,11 +144,11 @@ inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
 }
 
 inline vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
-        if (p.length_squared() < 1)
-            return p;
-    }
+    // Polar mapping with r = sqrt(u) keeps the density uniform over the disk's area.
+    auto r = sqrt(random_double());
+    double sin_phi, cos_phi;
+    sin_cos_turns(random_double(), sin_phi, cos_phi);
+    return vec3(r*cos_phi, r*sin_phi, 0);
 }
 
 // Type aliases for vec3
@@ -0,0 +1,126 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "hittable.h"
+#include "material.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Wavefront path tracing. Rather than following one path to its end before starting the next,
+// the renderer advances a whole wave of paths one bounce at a time, in stages:
+//
+//   sort       (secondary rays) order the live paths by ray direction and origin
+//   intersect  trace every live path's ray against the world
+//   sort       retire the paths that missed, and group the rest by material kind
+//   scatter    run each kind's scatter() over its group as one devirtualised loop
+//
+// Each stage is a tight loop over one kind of work, which keeps the branch predictor and the
+// instruction cache on a single code path, and the per-stage arrays are the shape a SIMD or GPU
+// kernel would want.
+
+inline uint64_t ray_coherence_key(const ray& r, const aabb& bounds) {
+    // Sort key that puts rays likely to visit the same BVH nodes next to each other: the
+    // direction octant first (rays of one octant traverse children in the same order), then
+    // the Morton code of the origin within `bounds`.
+    const vec3& d = r.direction();
+    uint64_t octant = (d.x() < 0 ? 4u : 0u) | (d.y() < 0 ? 2u : 0u) | (d.z() < 0 ? 1u : 0u);
+    return octant << 30 | morton_code(r.origin(), bounds);
+}
+
+inline void sort_rays_for_coherence(const std::vector<ray>& rays, std::vector<int>& order) {
+    // Reorders the ray indices in `order` by ray_coherence_key, with the Morton grid fitted to
+    // the origins of those rays. The 33-bit keys are sorted by three counting passes of 11 bits
+    // (LSD radix sort), which keeps the sort cheap next to the traversal it is meant to speed up.
+    aabb bounds;
+    for (int k : order)
+        bounds = aabb(bounds, aabb(rays[k].origin(), rays[k].origin()));
+
+    const int radix_bits = 11, buckets = 1 << radix_bits;
+    size_t n = order.size();
+    std::vector<std::pair<uint64_t, int>> keyed(n), scratch(n);
+    for (size_t i = 0; i < n; i++)
+        keyed[i] = std::make_pair(ray_coherence_key(rays[order[i]], bounds), order[i]);
+
+    for (int shift = 0; shift < 33; shift += radix_bits) {
+        std::vector<size_t> start(buckets + 1, 0);
+        for (const auto& entry : keyed)
+            start[(entry.first >> shift & (buckets - 1)) + 1]++;
+        for (int b = 0; b < buckets; b++)
+            start[b + 1] += start[b];
+        for (const auto& entry : keyed)
+            scratch[start[entry.first >> shift & (buckets - 1)]++] = entry;
+        keyed.swap(scratch);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        order[i] = keyed[i].second;
+}
+
+// State of every path in a wave, one array per field.
+struct path_queue {
+    std::vector<ray>        rays;        // Ray the path traces next
+    std::vector<hit_record> hits;        // Its closest hit, after the intersect stage
+    std::vector<color>      throughput;  // Product of the attenuations so far
+    std::vector<pcg32>      rng;         // The path's own random stream
+    std::vector<int>        pixel_x, pixel_y, sample;
+    std::vector<int>        bounce;      // Bounces taken so far
+    std::vector<int>        depth;       // Bounces left before max_depth cuts the path
+    std::vector<int>        slot;        // Where the path's radiance goes in the wave's results
+
+    std::vector<int> live;                             // Paths still being traced
+    std::vector<int> by_material[material_kind_count];  // Live paths that hit each material kind
+
+    void clear() {
+        rays.clear(); hits.clear(); throughput.clear(); rng.clear();
+        pixel_x.clear(); pixel_y.clear(); sample.clear();
+        bounce.clear(); depth.clear(); slot.clear();
+        live.clear();
+    }
+
+    int size() const { return static_cast<int>(rays.size()); }
+
+    void add(const ray& r, int i, int j, int s, int max_depth, const pcg32& stream, int result_slot) {
+        int k = size();
+        rays.push_back(r);
+        hits.emplace_back();
+        throughput.push_back(color(1,1,1));
+        rng.push_back(stream);
+        pixel_x.push_back(i);
+        pixel_y.push_back(j);
+        sample.push_back(s);
+        bounce.push_back(0);
+        depth.push_back(max_depth);
+        slot.push_back(result_slot);
+        live.push_back(k);
+    }
+
+    void sort_by_material() {
+        // Distributes the live paths over by_material, keeping their order within each kind.
+        for (auto& group : by_material)
+            group.clear();
+        for (int k : live)
+            by_material[static_cast<int>(hits[k].mat->kind)].push_back(k);
+        live.clear();
+    }
+};
+
+template <typename M>
+inline bool scatter_exact(const material& m, const ray& r_in, const hit_record& rec,
+                          color& attenuation, ray& scattered) {
+    // scatter() of a material known to be an M, called without virtual dispatch.
+    return static_cast<const M&>(m).M::scatter(r_in, rec, attenuation, scattered);
+}
+
+template <>
+inline bool scatter_exact<material>(const material& m, const ray& r_in, const hit_record& rec,
+                                    color& attenuation, ray& scattered) {
+    // Materials of kind `other`: nothing is known about them, so dispatch as usual.
+    return m.scatter(r_in, rec, attenuation, scattered);
+}
+
+#endif